@@ -0,0 +1,455 @@
+#ifndef CHAINSTORE_H
+#define CHAINSTORE_H
+//-----------------------------------------------------------------------
+// File: chainstore.h
+// Description: Streaming, checkpointable store for the chains of an
+//              ensemble MCMC run (e.g., emcee), with online estimates
+//              of the integrated autocorrelation time of each parameter.
+//
+//              The file is a 4096-byte header followed by one record per
+//              step: the nwalkers x ndim coordinates, row by row, then
+//              the nwalkers log-probabilities. The file is memory-mapped
+//              and grows by doubling as steps are appended. checkpoint()
+//              flushes the records to disk and only then advances the
+//              step count in the header, so a run that is killed loses
+//              at most the steps since its last checkpoint. Opening an
+//              existing file resumes from the last checkpoint.
+//
+//              Autocorrelation times are estimated with bounded memory.
+//              Each walker's chain of each parameter is reduced to at
+//              most 2*MAXBLOCKS block means; when that many blocks are
+//              full, adjacent blocks are merged and the block size k is
+//              doubled. The normalized autocorrelation function of the
+//              block means is computed with an FFT, averaged over the
+//              walkers and summed with Sokal's automatic window, which
+//              gives the time tau_B in blocks. Since the variance of the
+//              overall mean can be written using either the samples or
+//              the block means,
+//
+//                tau = k tau_B var(block means) / var(samples).
+//
+//              For k = 1 this is the usual estimate (as in emcee); for
+//              k >> tau it becomes the batch-means estimate. Appending a
+//              step costs O(nwalkers x ndim).
+//
+// Created: Oct. 2026
+//-----------------------------------------------------------------------
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+//-----------------------------------------------------------------------
+struct ChainStore
+{
+  // MAXRECORD bounds nwalkers x (ndim+1), the doubles in one step
+  enum { HEADERSIZE = 4096, MAXBLOCKS = 1024, MAXRECORD = 1 << 26 };
+
+  struct Header
+  {
+    char   magic[8];
+    long long nwalkers;
+    long long ndim;
+    long long nsteps;          // steps up to the last checkpoint
+  };
+
+  // block means of one walker and parameter
+  struct Blocks
+  {
+    std::vector<double> mean;  // completed blocks
+    double partial;            // sum of the current block
+    int    npartial;
+    double sum;                // sums over all samples
+    double sumsq;
+    Blocks() : mean(), partial(0), npartial(0), sum(0), sumsq(0) {}
+  };
+
+  std::string filename;
+  int    fd;
+  char*  base;                 // mapping of the whole file
+  size_t mapped;               // its size in bytes
+  long long capacity;          // steps that fit in the mapping
+  long long steps;             // steps appended
+  int    nwalkers;
+  int    ndim;
+  long long blocksize;         // samples per block
+  std::vector<Blocks> blocks;  // [walker*ndim + parameter]
+  double window;               // Sokal window constant
+
+  ChainStore()
+    : filename(""),
+      fd(-1),
+      base(0),
+      mapped(0),
+      capacity(0),
+      steps(0),
+      nwalkers(0),
+      ndim(0),
+      blocksize(1),
+      blocks(),
+      window(5)
+  {}
+
+  ~ChainStore() { close(); }
+
+  ChainStore(const ChainStore&) = delete;
+  ChainStore& operator=(const ChainStore&) = delete;
+
+  // create a new file, or truncate an existing one
+  bool create(std::string name, int _nwalkers, int _ndim,
+              long long _capacity=1024)
+  {
+    close();
+    if ( _nwalkers <= 0 || _ndim <= 0 || _ndim >= MAXRECORD / _nwalkers )
+      {
+        std::cout << "** ChainStore ** unsupported shape " << _nwalkers
+                  << " x " << _ndim << std::endl;
+        return false;
+      }
+    fd = ::open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if ( fd < 0 )
+      {
+        std::cout << "** ChainStore ** unable to create " << name
+                  << std::endl;
+        return false;
+      }
+    nwalkers = _nwalkers;
+    ndim = _ndim;
+    if ( !remap(std::max(1LL, _capacity)) )
+      {
+        close();
+        return false;
+      }
+    Header* h = header();
+    memcpy(h->magic, MAGIC(), 8);
+    h->nwalkers = nwalkers;
+    h->ndim = ndim;
+    h->nsteps = 0;
+    filename = name;
+    steps = 0;
+    reset();
+    return true;
+  }
+
+  // open an existing file and resume from its last checkpoint
+  bool open(std::string name)
+  {
+    close();
+    fd = ::open(name.c_str(), O_RDWR);
+    if ( fd < 0 ) return false;
+    Header h;
+    bool ok = ::read(fd, &h, sizeof(h)) == sizeof(h) &&
+      memcmp(h.magic, MAGIC(), 8) == 0 &&
+      h.nwalkers > 0 &&
+      h.ndim > 0 &&
+      h.ndim < MAXRECORD / h.nwalkers &&
+      h.nsteps >= 0;
+
+    // the steps declared must be in the file
+    struct stat st;
+    ok = ok && fstat(fd, &st) == 0 && st.st_size >= HEADERSIZE &&
+      h.nsteps <= (st.st_size - HEADERSIZE) /
+      (long long)(h.nwalkers * (h.ndim+1) * sizeof(double));
+    if ( !ok )
+      {
+        std::cout << "** ChainStore ** " << name << " is not a valid chain file"
+                  << std::endl;
+        close();
+        return false;
+      }
+    nwalkers = h.nwalkers;
+    ndim = h.ndim;
+    if ( !remap(std::max(1024LL, h.nsteps)) )
+      {
+        close();
+        return false;
+      }
+    filename = name;
+    steps = header()->nsteps;
+    reset();
+    for(long long k=0; k < steps; k++) update(record(k));
+    return true;
+  }
+
+  void close()
+  {
+    if ( base ) munmap(base, mapped);
+    if ( fd >= 0 ) ::close(fd);
+    base = 0;
+    mapped = 0;
+    fd = -1;
+    capacity = 0;
+    steps = 0;
+  }
+
+  bool good() const { return base != 0; }
+
+  long long size() const { return steps; }
+  int walkers() const { return nwalkers; }
+  int dimension() const { return ndim; }
+
+  // append one step: coords holds the nwalkers x ndim coordinates row
+  // by row, logprob the nwalkers log-probabilities
+  bool append(double* coords, double* logprob)
+  {
+    if ( !base ) return false;
+    if ( steps == capacity && !remap(2*capacity) ) return false;
+    double* r = record(steps);
+    memcpy(r, coords, (size_t)nwalkers*ndim*sizeof(double));
+    memcpy(r + nwalkers*ndim, logprob, nwalkers*sizeof(double));
+    update(r);
+    steps++;
+    return true;
+  }
+
+  // flush appended steps to disk, then record them in the header
+  bool checkpoint()
+  {
+    if ( !base ) return false;
+    bool ok = msync(base, mapped, MS_SYNC) == 0;
+    header()->nsteps = steps;
+    ok = ok && msync(base, HEADERSIZE, MS_SYNC) == 0;
+    if ( !ok )
+      std::cout << "** ChainStore ** unable to checkpoint " << filename
+                << std::endl;
+    return ok;
+  }
+
+  // copy the coordinates and log-probabilities of step k (by default,
+  // the last one)
+  bool last(double* coords, double* logprob=0, long long k=-1)
+  {
+    if ( k < 0 ) k = steps-1;
+    if ( !base || k < 0 || k >= steps ) return false;
+    double* r = record(k);
+    memcpy(coords, r, (size_t)nwalkers*ndim*sizeof(double));
+    if ( logprob ) memcpy(logprob, r + nwalkers*ndim,
+                          nwalkers*sizeof(double));
+    return true;
+  }
+
+  // number of points in the flattened chain returned by chain()
+  long long flatSize(long long discard=0, long long thin=1) const
+  {
+    thin = std::max(1LL, thin);
+    long long n = steps - std::max(0LL, discard);
+    return n > 0 ? nwalkers * ((n + thin-1) / thin) : 0;
+  }
+
+  // copy the chain, skipping the first discard steps and keeping every
+  // thin-th step, as flatSize() points of ndim coordinates (and, if
+  // given, their log-probabilities)
+  void chain(double* out, long long discard=0, long long thin=1,
+             double* logprob=0)
+  {
+    if ( !base ) return;
+    thin = std::max(1LL, thin);
+    for(long long k=std::max(0LL, discard); k < steps; k += thin)
+      {
+        double* r = record(k);
+        memcpy(out, r, (size_t)nwalkers*ndim*sizeof(double));
+        out += nwalkers*ndim;
+        if ( logprob )
+          {
+            memcpy(logprob, r + nwalkers*ndim, nwalkers*sizeof(double));
+            logprob += nwalkers;
+          }
+      }
+  }
+
+  // integrated autocorrelation time of parameter i, in steps; NAN if
+  // the chain is too short to tell
+  double tau(int i)
+  {
+    int nb = blocks.empty() ? 0 : (int)blocks[0].mean.size();
+    if ( nb < 16 ) return NAN;
+
+    int m = 1;
+    while ( m < 2*nb ) m *= 2;
+    std::vector<double> rho(nb, 0);
+    std::vector<std::complex<double> > f(m);
+    double vblock  = 0;
+    double vsample = 0;
+    for(int w=0; w < nwalkers; w++)
+      {
+        Blocks& B = blocks[w*ndim + i];
+        double mean = 0;
+        for(int j=0; j < nb; j++) mean += B.mean[j];
+        mean /= nb;
+        for(int j=0; j < m; j++)
+          f[j] = j < nb ? B.mean[j] - mean : 0;
+        fft(f, false);
+        for(int j=0; j < m; j++) f[j] = std::norm(f[j]);
+        fft(f, true);
+        double c0 = f[0].real();
+        if ( !(c0 > 0) ) continue;
+        for(int j=0; j < nb; j++) rho[j] += f[j].real() / c0;
+        vblock += c0 / ((double)m*nb);   // inverse FFT is not normalized
+
+        long long n = (long long)nb * blocksize + B.npartial;
+        double s = B.sum / n;
+        vsample += B.sumsq / n - s*s;
+      }
+    if ( !(rho[0] > 0) || !(vsample > 0) ) return NAN;
+    for(int j=1; j < nb; j++) rho[j] /= rho[0];
+    rho[0] = 1;
+
+    // Sokal: smallest window M with M >= window * tau_B(M)
+    double tauB = 1;
+    for(int M=1; M < nb; M++)
+      {
+        tauB += 2*rho[M];
+        if ( M >= window*tauB ) break;
+      }
+    return std::max(1.0, blocksize * tauB * vblock / vsample);
+  }
+
+  // largest autocorrelation time over the parameters
+  double maxTau()
+  {
+    double t = 0;
+    for(int i=0; i < ndim; i++)
+      {
+        double x = tau(i);
+        if ( std::isnan(x) ) return NAN;
+        t = std::max(t, x);
+      }
+    return t;
+  }
+
+  // effective number of independent samples, over all walkers
+  double effectiveSize()
+  {
+    double t = maxTau();
+    return std::isnan(t) ? 0 : nwalkers * steps / t;
+  }
+
+  // true when the run is longer than ntau autocorrelation times and
+  // has at least neff effective samples
+  bool converged(double neff, double ntau=50)
+  {
+    double t = maxTau();
+    if ( std::isnan(t) ) return false;
+    return steps > ntau*t && nwalkers * steps / t >= neff;
+  }
+
+  static const char* MAGIC() { return "QMULCHN1"; }
+
+private:
+  Header* header() { return reinterpret_cast<Header*>(base); }
+
+  size_t recordSize() const
+  {
+    return (size_t)nwalkers * (ndim+1) * sizeof(double);
+  }
+
+  double* record(long long k)
+  {
+    return reinterpret_cast<double*>(base + HEADERSIZE + k*recordSize());
+  }
+
+  // size the file for n steps and map it
+  bool remap(long long n)
+  {
+    size_t bytes = HEADERSIZE + n*recordSize();
+    struct stat st;
+    if ( fstat(fd, &st) != 0 ) return false;
+    if ( (size_t)st.st_size < bytes && ftruncate(fd, bytes) != 0 )
+      {
+        std::cout << "** ChainStore ** unable to grow " << filename
+                  << std::endl;
+        return false;
+      }
+    if ( base ) munmap(base, mapped);
+    void* p = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if ( p == MAP_FAILED )
+      {
+        base = 0;
+        mapped = 0;
+        std::cout << "** ChainStore ** unable to map " << filename
+                  << std::endl;
+        return false;
+      }
+    base = static_cast<char*>(p);
+    mapped = bytes;
+    capacity = n;
+    return true;
+  }
+
+  void reset()
+  {
+    blocksize = 1;
+    blocks.assign((size_t)nwalkers*ndim, Blocks());
+  }
+
+  // add the coordinates of one step to the block means
+  void update(double* coords)
+  {
+    bool full = false;
+    for(size_t c=0; c < blocks.size(); c++)
+      {
+        Blocks& B = blocks[c];
+        double x = coords[c];
+        B.sum   += x;
+        B.sumsq += x*x;
+        B.partial += x;
+        if ( ++B.npartial == blocksize )
+          {
+            B.mean.push_back(B.partial / blocksize);
+            B.partial = 0;
+            B.npartial = 0;
+            full = B.mean.size() == 2*MAXBLOCKS;
+          }
+      }
+    if ( !full ) return;
+
+    // merge adjacent blocks
+    for(size_t c=0; c < blocks.size(); c++)
+      {
+        std::vector<double>& m = blocks[c].mean;
+        for(int j=0; j < MAXBLOCKS; j++)
+          m[j] = 0.5*(m[2*j] + m[2*j+1]);
+        m.resize(MAXBLOCKS);
+      }
+    blocksize *= 2;
+  }
+
+  // in-place radix-2 FFT; the inverse is not normalized
+  static void fft(std::vector<std::complex<double> >& a, bool inverse)
+  {
+    int n = a.size();
+    for(int i=1, j=0; i < n; i++)
+      {
+        int bit = n >> 1;
+        for(; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if ( i < j ) std::swap(a[i], a[j]);
+      }
+    for(int len=2; len <= n; len <<= 1)
+      {
+        double angle = 2*M_PI/len * (inverse ? 1 : -1);
+        std::complex<double> wlen(cos(angle), sin(angle));
+        for(int i=0; i < n; i += len)
+          {
+            std::complex<double> w(1);
+            for(int j=0; j < len/2; j++)
+              {
+                std::complex<double> u = a[i+j];
+                std::complex<double> v = a[i+j+len/2] * w;
+                a[i+j] = u + v;
+                a[i+j+len/2] = u - v;
+                w *= wlen;
+              }
+          }
+      }
+  }
+};
+
+#endif
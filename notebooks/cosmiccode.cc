@@ -0,0 +1,697 @@
+//-----------------------------------------------------------------------
+// File: cosmiccode.cc
+// Description: Fit 3-parameter models to the latest compilation of 
+//              Type Ia supernova data.
+//
+//              a    - universal scale factor
+//
+//              OM   - Omega_M
+//              OL   - Omega_L
+//              H    - roughly related to Hubble's constant
+//
+//              For some models OM and OL may have different meanings.
+//
+//              The distance modulus can optionally be computed from
+//              a precomputed table (see cosmictable.h).
+//
+// Created: June 2008 HBP
+// Updated for the 2012 European School of High Energy Physics (ESHEP) 
+//                      La Pommeraye, Anjou, France
+//-----------------------------------------------------------------------
+#ifndef COSMICCODE_CC
+#define COSMICCODE_CC
+
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <map>
+#include "cosmictable.h"
+#include "supernovae.h"
+#include "hotpath.h"
+//-----------------------------------------------------------------------
+using namespace std;
+//-----------------------------------------------------------------------
+struct Model
+{
+  int ID;
+  std::map<std::string, int> mid;
+  
+  Model() : ID(0)
+  {
+    mid["LCDM"] = 0;
+    mid["phantom"] = 1;
+  }
+  
+  Model(std::string name)
+  {
+    mid["LCDM"] = 0;
+    mid["phantom"] = 1;
+    ID = mid[name];
+    
+    switch (ID)
+      {
+      case 0: // LCDM model
+      default:
+        std::cout << std::endl << "\tLCDM model" 
+                  << std::endl << std::endl;
+        break;
+      case 1: // phantom energy model
+        std::cout << std::endl << "\tphantom energy model" 
+                  << std::endl << std::endl;
+        break;
+      }    
+  }
+  ~Model() {}
+
+  int id() { return ID; }
+  
+  double operator()(double a, double* p)
+  {
+    assert(p);
+    double y = 0;
+    switch (ID)
+      {
+      case 0: // LCDM
+      default:
+        {
+          // a^3 * [Omega_M/a^3 + (1-Omega_M-Omega_L)/a^2 + Omega_L]
+          double OM = p[0];
+          double OL = p[1];
+          y = OM + (1 - OM - OL)*a + OL*a*a*a;
+        }
+        break;
+      case 1: // phantom
+        {
+          // p[0] = H0
+          // p[1] = n
+          // a^3 * [ exp(a^n-1)/a^3 ]
+          double n = p[1];
+          y = exp(pow(a, n)-1);
+        }
+        break;
+      }
+    return y;
+  }
+
+// check for valid parameter point
+    
+  bool valid(double* p)
+  {
+    assert(p);
+    
+    switch (ID)
+      {
+      case 0: // LCDM model
+      default:
+        {
+          double OM = p[0];
+          double OL = p[1];
+          double H0 = p[2];
+          if ( OM <  0 )   return false;
+          if ( OM >  5 )   return false;
+          if ( OL <  0 )   return false;
+          if ( OL >  5 )   return false;
+          if ( H0 <  1 )   return false;
+          if ( H0 >  200 ) return false;
+        }
+        break;
+      
+      case 1: // phantom model
+        {
+          double H0 = p[0];
+          double n  = p[1];
+          if ( H0 <  1 )   return false;
+          if ( H0 >  200 ) return false;
+          if ( n  <  0 )   return false;
+          if ( n  > 10 )   return false;
+        }
+        break;
+      }
+    return true;
+  }
+
+  // parameter ranges accepted by valid
+  void limits(double* lo, double* hi)
+  {
+    switch (ID)
+      {
+      case 0: // LCDM model
+      default:
+        lo[0] = 0; hi[0] = 5;     // OM
+        lo[1] = 0; hi[1] = 5;     // OL
+        lo[2] = 1; hi[2] = 200;   // H0
+        break;
+      case 1: // phantom model
+        lo[0] = 1; hi[0] = 200;   // H0
+        lo[1] = 0; hi[1] = 10;    // n
+        break;
+      }
+  }
+
+  // number of parameters
+  int size()
+  {
+    switch (ID)
+      {
+      case 0: // LCDM model
+      default:
+        return 3;
+      case 1: // phantom model
+        return 2;
+      }
+  }
+
+  // position of H0 in parameter array
+  int h0index()
+  {
+    switch (ID)
+      {
+      case 0: // LCDM model
+      default:
+        return 2;
+      case 1: // phantom model
+        return 0;
+      }
+  }
+};
+
+struct CosmicCode
+{
+  Model model;
+  int N;
+  int ID; 
+  double offset;
+  DistanceTable table;
+  bool usetable;
+  
+  CosmicCode() 
+        : model(Model()),
+          N(500),
+          ID(model.id()),
+          offset(5*log10(2.99792*pow(10.0, 5.0)) + 25),
+          table(),
+          usetable(false)
+    {}
+    
+  CosmicCode(std::string name, int _N=500)
+    : model(Model(name)),
+      N(_N),
+      offset(5*log10(2.99792*pow(10.0, 5.0)) + 25),
+      ID(model.id()),
+      table(),
+      usetable(false)
+  {}
+    
+  ~CosmicCode() {}
+
+  void setN(int N_) { N = N_; usetable = usetable && N == table.N; }
+  void setModel(std::string name) 
+  {
+    model = Model(name); 
+    ID = model.id();
+    usetable = usetable && ID == table.modelID;
+  }
+
+  // copy parameters other than H0 from p to q, and back
+  void reduce(double* p, double* q)
+  {
+    int k = model.h0index();
+    for(int i=0, j=0; i < model.size(); i++) if ( i != k ) q[j++] = p[i];
+  }
+
+  void expand(double* q, double H0, double* p)
+  {
+    int k = model.h0index();
+    for(int i=0, j=0; i < model.size(); i++) p[i] = i == k ? H0 : q[j++];
+  }
+
+  // compute transverse comoving distance in units of c/H0; that is,
+  // the comoving integral F corrected for spatial curvature
+  double transverseDistance(double z, double* p)
+  {
+    hotpath::count(hotpath::QUADRATURE, N);
+    double a = 1.0/(1+z);
+    double h = (1-a) / N;
+    double F = 0;
+    for(int i=0; i < N; i++)
+      {
+        double x = a + (i+0.5)*h;
+        double q = x * model(x, p);
+        if ( q < 0 ) return NAN;
+        F = F + 1.0/sqrt(q);
+      }
+    F = F*h;
+    
+    switch (ID)
+      {
+      case 0: // LCDM model
+      default:
+        {
+          double OM = p[0];
+          double OL = p[1];
+          double OK = 1 - OM - OL;
+          double rootOK = sqrt(fabs(OK));
+          double theta  = rootOK * F;
+          if      ( OK > 0 )
+            F = sinh(theta) / rootOK;
+          else if ( OK < 0 )
+            F = sin(theta)  / rootOK;
+        }
+        break;
+      case 1: // phantom energy model
+        break;
+      }
+    return F;
+  }
+
+  // compute reduced distance modulus L(z, q) = 5 log10[(1+z) S(F) / z],
+  // where q are the parameters other than H0. L is finite at z = 0.
+  double reducedModulus(double z, double* q)
+  {
+    double p[DistanceTable::MAXDIM+1];
+    expand(q, 1, p);
+    if ( z <= 0 )
+      {
+        double y = model(1, p);
+        if ( y <= 0 ) return NAN;
+        return -2.5*log10(y);
+      }
+    return 5*log10( (1+z) * transverseDistance(z, p) / z);
+  }
+    
+  double distanceModulus(double z, double* p)
+  {
+    double H0 = p[model.h0index()];
+
+    if ( usetable && table.contains(z) )
+      {
+        double q[DistanceTable::MAXDIM];
+        double cz[DistanceTable::MAXORDER];
+        reduce(p, q);
+        if ( table.slice(q, cz) )
+          return table.evalz(cz, z) + 5*log10(z / H0) + offset;
+      }
+
+    double y = 5*log10( (1+z) * transverseDistance(z, p) / H0) + offset;
+
+    return y;
+  }
+
+  // if the table covers parameter point p, contract over the parameters
+  // and return true, leaving the coefficients of the series in z in cz
+  bool prepare(double* p, double* cz)
+  {
+    if ( !usetable ) return false;
+    double q[DistanceTable::MAXDIM];
+    reduce(p, q);
+    return table.slice(q, cz);
+  }
+
+  // distance modulus at parameter point p, using the coefficients cz
+  // from prepare when fast is true. H = offset - 5 log10(H0).
+  double modulus(double z, double* p, bool fast, double* cz, double H)
+  {
+    if ( fast && table.contains(z) )
+      return table.evalz(cz, z) + 5*log10(z) + H;
+    return distanceModulus(z, p);
+  }
+
+  double logLikelihood(double* p,
+                       double* z,
+                       double* x,
+                       double* dx,
+                       int n)
+  {
+    hotpath::Timer t(hotpath::LIKELIHOOD);
+    // with a table, contract over the parameters once and sum
+    // a one-dimensional Chebyshev series per supernova
+    double cz[DistanceTable::MAXORDER];
+    bool fast = prepare(p, cz);
+    double H = offset - 5*log10(p[model.h0index()]);
+
+    double chisq = 0;
+    for(int c=0; c < n; c++)
+      {
+        double y = (x[c] - modulus(z[c], p, fast, cz, H)) / dx[c];
+        chisq += y*y;
+      }
+    return -0.5*chisq;
+  }
+
+  //--------------------------------------------------------------------
+  // H0 enters the distance modulus only through the additive term
+  // d = -5 log10(H0), so chi^2 is quadratic in d:
+  //
+  //   chi^2(d) = chi^2_min + S0 (d - dhat)^2,
+  //
+  // with S0 = sum 1/dx^2, dhat = S1/S0, S1 = sum r/dx^2 and r = x - mu
+  // computed at H0 = 1. H0 can therefore be profiled or marginalized
+  // in closed form.
+  //--------------------------------------------------------------------
+  enum { PROFILE=1, MARGINAL=2 };
+
+  // range of H0 allowed by Model::valid
+  double H0min()
+  {
+    double lo[DistanceTable::MAXDIM+1], hi[DistanceTable::MAXDIM+1];
+    model.limits(lo, hi);
+    return lo[model.h0index()];
+  }
+  double H0max()
+  {
+    double lo[DistanceTable::MAXDIM+1], hi[DistanceTable::MAXDIM+1];
+    model.limits(lo, hi);
+    return hi[model.h0index()];
+  }
+
+  // Return the log-likelihood as a function of the parameters q other
+  // than H0, with H0 removed analytically:
+  //
+  //   mode = PROFILE    log L(q, H0hat(q)), with H0hat clipped to
+  //                     [H0min, H0max]
+  //   mode = MARGINAL   log of the integral of L over a prior flat in
+  //                     log(H0) (i.e., in d) on [H0min, H0max]
+  //
+  // If h0 is given, return the best-fit value of H0 in [H0min, H0max]
+  // in h0[0] and its uncertainty, from the width of the likelihood in
+  // d, in h0[1].
+  double logLikelihoodH0(double* q,
+                         double* z,
+                         double* x,
+                         double* dx,
+                         int n,
+                         int mode=PROFILE,
+                         double* h0=0)
+  {
+    hotpath::Timer t(hotpath::LIKELIHOOD);
+    double p[DistanceTable::MAXDIM+1];
+    expand(q, 1, p);
+    double cz[DistanceTable::MAXORDER];
+    bool fast = prepare(p, cz);
+
+    double S0 = 0;
+    double S1 = 0;
+    double S2 = 0;
+    for(int c=0; c < n; c++)
+      {
+        double w = 1.0 / (dx[c]*dx[c]);
+        double r = x[c] - modulus(z[c], p, fast, cz, offset);
+        S0 += w;
+        S1 += w*r;
+        S2 += w*r*r;
+      }
+    double S[3] = {S0, S1, S2};
+    return removeH0(S, mode, h0);
+  }
+
+  // Return the log-likelihood with H0 removed, given the weighted
+  // residual sums S (computed at H0 = 1) described above
+  double removeH0(double* S, int mode, double* h0)
+  {
+    double dhat  = S[1] / S[0];
+    double chisq = S[2] - S[1]*dhat;
+
+    // the maximum of L within the allowed range of H0, which is at the
+    // nearer edge if dhat falls outside it
+    double dlo = -5*log10(H0max());
+    double dhi = -5*log10(H0min());
+    double d   = std::min(dhi, std::max(dlo, dhat));
+
+    if ( h0 )
+      {
+        h0[0] = pow(10.0, -d/5);
+        h0[1] = h0[0] * log(10.0) / (5*sqrt(S[0]));
+      }
+
+    if ( mode != MARGINAL ) return -0.5*(chisq + S[0]*(d-dhat)*(d-dhat));
+
+    double t   = sqrt(0.5*S[0]);
+    double y   = erf((dhi-dhat)*t) - erf((dlo-dhat)*t);
+    if ( !(y > 0) ) return -INFINITY;
+    return -0.5*chisq + 0.5*log(M_PI/(2*S[0])) + log(y/(dhi-dlo));
+  }
+
+  // Compute logLikelihoodH0 on a grid of nx x ny points spanning the box
+  // [lo, hi] of the parameters other than H0 (ny is ignored for models
+  // with one such parameter). Results are stored row by row in loglike
+  // and, if given, the best-fit H0 in h0.
+  void scanH0(int mode,
+              double* lo,
+              double* hi,
+              int nx,
+              int ny,
+              double* z,
+              double* x,
+              double* dx,
+              int n,
+              double* loglike,
+              double* h0=0)
+  {
+    if ( model.size() < 3 ) ny = 1;
+    double q[DistanceTable::MAXDIM];
+    double h[2];
+    for(int i=0; i < nx; i++)
+      for(int j=0; j < ny; j++)
+        {
+          q[0] = lo[0] + (nx > 1 ? (hi[0]-lo[0])*i/(nx-1) : 0);
+          if ( model.size() > 2 )
+            q[1] = lo[1] + (ny > 1 ? (hi[1]-lo[1])*j/(ny-1) : 0);
+          loglike[i*ny+j] = logLikelihoodH0(q, z, x, dx, n, mode, h);
+          if ( h0 ) h0[i*ny+j] = h[0];
+        }
+  }
+
+  //--------------------------------------------------------------------
+  // Versions of the likelihoods for a resident dataset (supernovae.h).
+  // When the table covers the parameter point and the data, the model
+  // and the residual sums are computed by vectorized kernels.
+  //--------------------------------------------------------------------
+
+  // Accumulate the weighted residual sums S (see SupernovaData::sums)
+  // at parameter point p, with H = offset - 5 log10(H0)
+  void residualSums(double* p, SupernovaData& data, double H, double* S)
+  {
+    double cz[DistanceTable::MAXORDER];
+    if ( prepare(p, cz) && data.bind(table.zmax) )
+      data.series(cz, table.zorder);
+    else
+      for(int c=0; c < data.n; c++)
+        {
+          double z = data.z[c];
+          data.m[c] = 5*log10( (1+z) * transverseDistance(z, p) );
+        }
+    data.sums(H, S);
+  }
+
+  double logLikelihood(double* p, SupernovaData& data)
+  {
+    hotpath::Timer t(hotpath::LIKELIHOOD);
+    double S[3];
+    residualSums(p, data, offset - 5*log10(p[model.h0index()]), S);
+    return -0.5*S[2];
+  }
+
+  double logLikelihoodH0(double* q,
+                         SupernovaData& data,
+                         int mode=PROFILE,
+                         double* h0=0)
+  {
+    hotpath::Timer t(hotpath::LIKELIHOOD);
+    double p[DistanceTable::MAXDIM+1];
+    expand(q, 1, p);
+    double S[3];
+    residualSums(p, data, offset, S);
+    return removeH0(S, mode, h0);
+  }
+
+  //--------------------------------------------------------------------
+  // Batch versions for Python. NumPy arrays are used in place, without
+  // copying, and no Python objects are touched, so these can be called
+  // with the GIL released (see cosmiccode.ipynb). Parameter points are
+  // stored row by row in P (model.size() columns) or, with H0 removed,
+  // in Q (model.size()-1 columns).
+  //
+  // The versions that take raw arrays only read shared state and may
+  // be called concurrently. Those that take a SupernovaData object use
+  // its model column as scratch space, so concurrent calls must use
+  // different datasets.
+  //--------------------------------------------------------------------
+
+  // distance moduli mu[i] at redshifts z[i], i = 0,...,n-1
+  void distanceModuli(double* p, double* z, int n, double* mu)
+  {
+    double cz[DistanceTable::MAXORDER];
+    bool fast = prepare(p, cz);
+    double H = offset - 5*log10(p[model.h0index()]);
+    for(int i=0; i < n; i++)
+      mu[i] = modulus(z[i], p, fast, cz, H);
+  }
+
+  void logLikelihoods(double* P, int m,
+                      double* z,
+                      double* x,
+                      double* dx,
+                      int n,
+                      double* loglike)
+  {
+    int d = model.size();
+    for(int k=0; k < m; k++)
+      loglike[k] = logLikelihood(&P[k*d], z, x, dx, n);
+  }
+
+  void logLikelihoods(double* P, int m, SupernovaData& data,
+                      double* loglike)
+  {
+    int d = model.size();
+    for(int k=0; k < m; k++)
+      loglike[k] = logLikelihood(&P[k*d], data);
+  }
+
+  // if h0 is given, the best-fit H0 of point k is returned in h0[k]
+  void logLikelihoodsH0(double* Q, int m,
+                        double* z,
+                        double* x,
+                        double* dx,
+                        int n,
+                        int mode,
+                        double* loglike,
+                        double* h0=0)
+  {
+    int d = model.size()-1;
+    double h[2];
+    for(int k=0; k < m; k++)
+      {
+        loglike[k] = logLikelihoodH0(&Q[k*d], z, x, dx, n, mode, h);
+        if ( h0 ) h0[k] = h[0];
+      }
+  }
+
+  void logLikelihoodsH0(double* Q, int m, SupernovaData& data,
+                        int mode,
+                        double* loglike,
+                        double* h0=0)
+  {
+    int d = model.size()-1;
+    double h[2];
+    for(int k=0; k < m; k++)
+      {
+        loglike[k] = logLikelihoodH0(&Q[k*d], data, mode, h);
+        if ( h0 ) h0[k] = h[0];
+      }
+  }
+
+  // build table of the reduced distance modulus over the redshift range
+  // [0, zmax] and the box [lo, hi] of parameters other than H0, which
+  // is divided into npatch[i] patches along parameter i. The table is
+  // saved to filename and switched on.
+  bool makeTable(std::string filename,
+                 double zmax,
+                 double* lo,
+                 double* hi,
+                 int* npatch,
+                 int zorder=16,
+                 int porder=8,
+                 double tolerance=1.e-4)
+  {
+    if ( zorder > DistanceTable::MAXORDER || 
+         porder > DistanceTable::MAXORDER )
+      {
+        cout << "** CosmicCode ** maximum table order is " 
+             << DistanceTable::MAXORDER << endl;
+        return false;
+      }
+    if ( !table.setup(ID, N, model.size()-1, zmax, lo, hi, npatch,
+                      zorder, porder, tolerance) )
+      {
+        usetable = false;
+        return false;
+      }
+    table.build(*this);
+    usetable = true;
+    return table.write(filename);
+  }
+
+  // load a table made with makeTable and switch it on
+  bool loadTable(std::string filename)
+  {
+    usetable = false;
+    if ( !table.read(filename) ) return false;
+    if ( table.modelID != ID || table.N != N )
+      {
+        cout << "** CosmicCode ** table " << filename
+             << " was made for a different model or N" << endl;
+        table = DistanceTable();
+        return false;
+      }
+    usetable = true;
+    return true;
+  }
+
+  // switch the table on or off. It is switched on only if it was made
+  // for this model and N, as checked by loadTable.
+  void useTable(bool yes=true)
+  {
+    usetable = false;
+    if ( !yes || table.empty() ) return;
+    if ( table.modelID != ID || table.N != N )
+      {
+        cout << "** CosmicCode ** table was made for a different model or N"
+             << endl;
+        return;
+      }
+    usetable = true;
+  }
+
+  // used by DistanceTable::build
+  double operator()(double z, double* q) { return reducedModulus(z, q); }
+ 
+  // compute lifetime vs scale factor
+  void scaleFactor(double amax, double* p, double* t, double* a)
+  {
+    double F = 0;
+    double h = amax / N;
+    for(int i=0; i < N; i++)
+      {
+        double x = (i+0.5)*h;
+        F = F + sqrt(x / model(x, p));
+        a[i] = x + 0.5*h;
+        t[i] = F*h;
+      }
+  }
+
+  // compute comoving distance vs. scale factor 
+  void comovingDistance(double amax, double* p, double* chi, double* a)
+  {
+    double F = 0;
+    double h = amax / N;
+    for(int i=0; i < N; i++)
+      {
+        double x = (i+0.5)*h;
+        F = F + 1.0 / sqrt(x * model(x, p));
+        a[i] = x + 0.5*h;
+        chi[i] = F*h;
+      }
+  }
+
+  // compute Omega(a)
+  void Omega(double amax, double* p, double* a, double* O)
+  {
+    double h = amax / N;
+    for(int i=0; i < N; i++)
+      {
+        double x = (i+0.5)*h;
+        a[i] = x + 0.5*h;
+        O[i] = model(a[i], p) / pow(a[i], 3);
+      }
+  }
+};
+
+// tools built on CosmicCode
+#include "nested.h"
+#include "chainstore.h"
+#include "fisher.h"
+#include "resample.h"
+
+#endif
@@ -0,0 +1,493 @@
+#ifndef COSMICTABLE_H
+#define COSMICTABLE_H
+//-----------------------------------------------------------------------
+// File: cosmictable.h
+// Description: Precomputed table of the reduced distance modulus
+//
+//                L(z, q) = 5 log10[ (1+z) S(F) / z ]
+//
+//              where F is the comoving integral computed by CosmicCode,
+//              S(F) its curvature-corrected value and q the model
+//              parameters other than H0, so that
+//
+//                mu = L(z, q) + 5 log10(z) - 5 log10(H0) + offset.
+//
+//              L is smooth and finite at z = 0, which makes it a good
+//              candidate for Chebyshev interpolation. The redshift range
+//              [0, zmax] is covered by a single expansion, while the
+//              parameter box is cut into patches, each with its own
+//              tensor-product Chebyshev expansion.
+//
+//              Every patch is checked against the direct calculation
+//              on a uniform grid that includes the patch edges. The
+//              error estimate of a patch is the largest deviation found
+//              plus the sum of the magnitudes of the highest-order
+//              coefficients (an estimate of the truncation error). It
+//              is a checked estimate, not a rigorous bound: the error
+//              between the check points and the dropped orders are not
+//              bounded. Patches whose estimate exceeds the tolerance,
+//              or that touch an unphysical region of parameter space,
+//              are flagged so that CosmicCode falls back to the direct
+//              calculation.
+//
+//              The table is written as a flat binary file that is
+//              read back with a handful of freads.
+//
+// Created: Oct. 2026
+//-----------------------------------------------------------------------
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+//-----------------------------------------------------------------------
+struct DistanceTable
+{
+  // MAXCOEF bounds porder^ndim, the number of parameter coefficients
+  // contracted per term in z, so that slice needs no heap allocation
+  enum { MAXDIM = 3, MAXORDER = 32, MAXCOEF = 4096 };
+
+  int    modelID;               // model for which table was built
+  int    N;                     // number of quadrature points used
+  int    ndim;                  // number of tabulated model parameters
+  int    zorder;                // number of Chebyshev terms in z
+  int    porder;                // number of Chebyshev terms per parameter
+  int    npatch[MAXDIM];        // number of patches per parameter
+  double zmax;                  // redshift range is [0, zmax]
+  double lo[MAXDIM];            // parameter box
+  double hi[MAXDIM];
+  double tolerance;             // required |mu(table) - mu| (estimated)
+  double maxerror;              // largest estimate over usable patches
+  int    M;                     // porder^ndim
+  int    ncoef;                 // coefficients per patch
+
+  std::vector<int>    status;   // 1 if patch is usable
+  std::vector<double> error;    // error estimate per patch
+  std::vector<double> coef;     // coefficients, patch by patch
+
+  DistanceTable()
+    : modelID(-1),
+      N(0),
+      ndim(0),
+      zorder(0),
+      porder(0),
+      zmax(0),
+      tolerance(0),
+      maxerror(0),
+      M(0),
+      ncoef(0)
+  {
+    for(int d=0; d < MAXDIM; d++)
+      {
+        npatch[d] = 1;
+        lo[d] = hi[d] = 0;
+      }
+  }
+
+  ~DistanceTable() {}
+
+  bool empty() const { return coef.size() == 0; }
+
+  int patches() const
+  {
+    int n = 1;
+    for(int d=0; d < ndim; d++) n *= npatch[d];
+    return n;
+  }
+
+  // Return false, leaving the table empty, if the dimensions are not
+  // supported.
+  bool setup(int id, int _N, int _ndim, double _zmax,
+             const double* _lo, const double* _hi, const int* _npatch,
+             int _zorder, int _porder, double _tolerance)
+  {
+    coef.clear();
+    if ( _ndim < 0 || _ndim > MAXDIM )
+      {
+        std::cout << "** DistanceTable ** at most " << MAXDIM
+                  << " tabulated parameters" << std::endl;
+        return false;
+      }
+    modelID = id;
+    N       = _N;
+    ndim    = _ndim;
+    zmax    = _zmax;
+    zorder  = _zorder;
+    porder  = _porder;
+    tolerance = _tolerance;
+    maxerror  = 0;
+    for(int d=0; d < ndim; d++)
+      {
+        lo[d] = _lo[d];
+        hi[d] = _hi[d];
+        npatch[d] = _npatch[d] > 0 ? _npatch[d] : 1;
+      }
+    M = 1;
+    for(int d=0; d < ndim; d++) M *= porder;
+    ncoef = zorder * M;
+    if ( !valid() )
+      {
+        char record[120];
+        sprintf(record, "** DistanceTable ** unsupported table: zorder = %d "
+                "(max %d), porder^ndim = %d (max %d), or empty box",
+                zorder, MAXORDER, M, MAXCOEF);
+        std::cout << record << std::endl;
+        return false;
+      }
+    status.assign(patches(), 0);
+    error.assign(patches(), 0);
+    coef.assign(patches() * ncoef, 0);
+    return true;
+  }
+
+  // Check that the dimensions are within the fixed buffers used to
+  // evaluate the table and are consistent with each other
+  bool valid() const
+  {
+    if ( ndim < 0 || ndim > MAXDIM ) return false;
+    if ( zorder < 1 || zorder > MAXORDER ) return false;
+    if ( porder < 1 || porder > MAXORDER ) return false;
+    int m = 1;
+    long long P = 1;
+    for(int d=0; d < ndim; d++)
+      {
+        if ( npatch[d] < 1 ) return false;
+        if ( !(lo[d] < hi[d]) ) return false;
+        m *= porder;
+        P *= npatch[d];
+        if ( P > INT_MAX ) return false;
+      }
+    return M == m && M <= MAXCOEF && ncoef == zorder * M &&
+      P * ncoef <= INT_MAX &&
+      zmax > 0 && std::isfinite(zmax);
+  }
+
+  // Locate the patch containing q and map q to [-1, 1] within it.
+  // Return -1 if q is outside the box or the patch is not usable.
+  int find(const double* q, double* u) const
+  {
+    int ip = 0;
+    for(int d=0; d < ndim; d++)
+      {
+        if ( !(q[d] >= lo[d] && q[d] <= hi[d]) ) return -1;
+        double w = (hi[d] - lo[d]) / npatch[d];
+        int k = (int)((q[d] - lo[d]) / w);
+        if ( k >= npatch[d] ) k = npatch[d] - 1;
+        u[d] = 2 * (q[d] - (lo[d] + k*w)) / w - 1;
+        ip = ip * npatch[d] + k;
+      }
+    return status[ip] ? ip : -1;
+  }
+
+  // Compute the products of Chebyshev polynomials T_j(u_d), one per
+  // combination of parameter indices, in row-major order
+  void weights(const double* u, double* w) const
+  {
+    int m = 1;
+    w[0] = 1;
+    for(int d=0; d < ndim; d++)
+      {
+        double T[MAXORDER];
+        T[0] = 1;
+        if ( porder > 1 ) T[1] = u[d];
+        for(int j=2; j < porder; j++) T[j] = 2*u[d]*T[j-1] - T[j-2];
+
+        for(int i=m-1; i >= 0; i--)
+          {
+            double wi = w[i];
+            for(int j=porder-1; j >= 0; j--) w[i*porder + j] = wi * T[j];
+          }
+        m *= porder;
+      }
+  }
+
+  // Contract the parameter dimensions for the parameter point q, leaving
+  // the zorder coefficients of the expansion in z. Return false if q is
+  // not covered by a usable patch.
+  bool slice(const double* q, double* cz) const
+  {
+    if ( empty() ) return false;
+    double u[MAXDIM];
+    int ip = find(q, u);
+    if ( ip < 0 ) return false;
+
+    double w[MAXCOEF];
+    weights(u, w);
+    const double* c = &coef[ip * ncoef];
+    for(int iz=0; iz < zorder; iz++, c += M)
+      {
+        double sum = 0;
+        for(int m=0; m < M; m++) sum += c[m] * w[m];
+        cz[iz] = sum;
+      }
+    return true;
+  }
+
+  bool contains(double z) const { return z >= 0 && z <= zmax; }
+
+  // Sum the Chebyshev series in z (Clenshaw's recurrence)
+  double evalz(const double* cz, double z) const
+  {
+    double t  = 2 * z / zmax - 1;
+    double t2 = 2 * t;
+    double b1 = 0;
+    double b2 = 0;
+    for(int j=zorder-1; j > 0; j--)
+      {
+        double b0 = t2*b1 - b2 + cz[j];
+        b2 = b1;
+        b1 = b0;
+      }
+    return t*b1 - b2 + cz[0];
+  }
+
+  // Return L(z, q). The caller must check that z and q are covered.
+  double operator()(double z, const double* q) const
+  {
+    double cz[MAXORDER];
+    slice(q, cz);
+    return evalz(cz, z);
+  }
+
+  // Build the table using a function f(z, q) that returns L(z, q)
+  template <class Function>
+  void build(Function& f)
+  {
+    int P = patches();
+    std::vector<double> v(ncoef);
+    std::vector<double> w(M);
+
+    maxerror = 0;
+    int nusable = 0;
+    for(int ip=0; ip < P; ip++)
+      {
+        // patch bounds
+        double a[MAXDIM];
+        double b[MAXDIM];
+        int k = ip;
+        for(int d=ndim-1; d >= 0; d--)
+          {
+            double width = (hi[d] - lo[d]) / npatch[d];
+            a[d] = lo[d] + (k % npatch[d]) * width;
+            b[d] = a[d] + width;
+            k /= npatch[d];
+          }
+
+        // sample at Chebyshev nodes
+        status[ip] = 0;
+        error[ip]  = 0;
+        bool ok = true;
+        double q[MAXDIM];
+        for(int iz=0; iz < zorder && ok; iz++)
+          {
+            double z = 0.5*zmax*(1 + node(iz, zorder));
+            for(int m=0; m < M && ok; m++)
+              {
+                int r = m;
+                for(int d=ndim-1; d >= 0; d--)
+                  {
+                    double x = node(r % porder, porder);
+                    q[d] = 0.5*(a[d] + b[d]) + 0.5*(b[d] - a[d])*x;
+                    r /= porder;
+                  }
+                v[iz*M + m] = f(z, q);
+                ok = std::isfinite(v[iz*M + m]);
+              }
+          }
+        if ( !ok ) continue;
+
+        // transform to Chebyshev coefficients, one axis at a time
+        transform(&v[0], 1, zorder, M);
+        int outer = zorder;
+        int inner = M;
+        for(int d=0; d < ndim; d++)
+          {
+            inner /= porder;
+            transform(&v[0], outer, porder, inner);
+            outer *= porder;
+          }
+        double* c = &coef[ip * ncoef];
+        for(int i=0; i < ncoef; i++) c[i] = v[i];
+
+        // truncation estimate: highest-order coefficients in any axis
+        double tail = 0;
+        for(int i=0; i < ncoef; i++)
+          {
+            int r = i % M;
+            bool last = (i / M) == zorder-1;
+            for(int d=ndim-1; d >= 0 && !last; d--)
+              {
+                last = (r % porder) == porder-1;
+                r /= porder;
+              }
+            if ( last ) tail += fabs(c[i]);
+          }
+
+        // compare with direct calculation on a grid that includes edges
+        status[ip] = 1;
+        double maxdev = 0;
+        int ncheck = 1;
+        for(int d=0; d < ndim; d++) ncheck *= porder + 1;
+        for(int iz=0; iz <= zorder && ok; iz++)
+          {
+            double z = zmax * iz / zorder;
+            for(int m=0; m < ncheck && ok; m++)
+              {
+                int r = m;
+                for(int d=ndim-1; d >= 0; d--)
+                  {
+                    q[d] = a[d] + (b[d] - a[d]) * (r % (porder+1)) / porder;
+                    r /= porder + 1;
+                  }
+                double y = f(z, q);
+                ok = std::isfinite(y);
+                if ( !ok ) break;
+
+                // evaluate within this patch (q may sit on an edge)
+                double u[MAXDIM];
+                for(int d=0; d < ndim; d++)
+                  u[d] = 2 * (q[d] - a[d]) / (b[d] - a[d]) - 1;
+                weights(u, &w[0]);
+                double cz[MAXORDER];
+                for(int jz=0; jz < zorder; jz++)
+                  {
+                    double sum = 0;
+                    for(int j=0; j < M; j++) sum += c[jz*M + j] * w[j];
+                    cz[jz] = sum;
+                  }
+                double dev = fabs(evalz(cz, z) - y);
+                if ( dev > maxdev ) maxdev = dev;
+              }
+          }
+        error[ip]  = maxdev + tail;
+        status[ip] = ok && error[ip] <= tolerance ? 1 : 0;
+        if ( status[ip] )
+          {
+            nusable++;
+            if ( error[ip] > maxerror ) maxerror = error[ip];
+          }
+      }
+
+    char record[120];
+    sprintf(record, "DistanceTable: %d of %d patches usable; "
+            "estimated |delta mu| < %9.2e", nusable, P, maxerror);
+    std::cout << record << std::endl;
+  }
+
+  bool write(std::string filename) const
+  {
+    FILE* f = fopen(filename.c_str(), "wb");
+    if ( !f )
+      {
+        std::cout << "** DistanceTable ** unable to open " << filename
+                  << std::endl;
+        return false;
+      }
+    int header[7] = {modelID, N, ndim, zorder, porder, M, ncoef};
+    fwrite(MAGIC(), 1, 8, f);
+    fwrite(header, sizeof(int), 7, f);
+    fwrite(npatch, sizeof(int), MAXDIM, f);
+    double range[2] = {zmax, tolerance};
+    fwrite(range, sizeof(double), 2, f);
+    fwrite(lo, sizeof(double), MAXDIM, f);
+    fwrite(hi, sizeof(double), MAXDIM, f);
+    fwrite(&maxerror, sizeof(double), 1, f);
+    fwrite(&status[0], sizeof(int), status.size(), f);
+    fwrite(&error[0], sizeof(double), error.size(), f);
+    fwrite(&coef[0], sizeof(double), coef.size(), f);
+    fclose(f);
+    return true;
+  }
+
+  bool read(std::string filename)
+  {
+    FILE* f = fopen(filename.c_str(), "rb");
+    if ( !f ) return false;
+
+    char magic[8];
+    int header[7];
+    double range[2];
+    bool ok = fread(magic, 1, 8, f) == 8 &&
+      memcmp(magic, MAGIC(), 8) == 0 &&
+      fread(header, sizeof(int), 7, f) == 7 &&
+      fread(npatch, sizeof(int), MAXDIM, f) == MAXDIM &&
+      fread(range, sizeof(double), 2, f) == 2 &&
+      fread(lo, sizeof(double), MAXDIM, f) == MAXDIM &&
+      fread(hi, sizeof(double), MAXDIM, f) == MAXDIM &&
+      fread(&maxerror, sizeof(double), 1, f) == 1;
+    if ( ok )
+      {
+        modelID = header[0];
+        N       = header[1];
+        ndim    = header[2];
+        zorder  = header[3];
+        porder  = header[4];
+        M       = header[5];
+        ncoef   = header[6];
+        zmax    = range[0];
+        tolerance = range[1];
+        ok = valid();
+      }
+    if ( ok )
+      {
+        // the rest of the file must hold exactly the patches declared
+        long long P = patches();
+        long here = ftell(f);
+        ok = fseek(f, 0, SEEK_END) == 0 &&
+          ftell(f) - here ==
+          P * (long long)(sizeof(int) + (1 + ncoef)*sizeof(double)) &&
+          fseek(f, here, SEEK_SET) == 0;
+      }
+    if ( ok )
+      {
+        int P = patches();
+        status.resize(P);
+        error.resize(P);
+        coef.resize(P * ncoef);
+        ok = (int)fread(&status[0], sizeof(int), P, f) == P &&
+          (int)fread(&error[0], sizeof(double), P, f) == P &&
+          fread(&coef[0], sizeof(double), coef.size(), f) == coef.size();
+      }
+    fclose(f);
+    if ( !ok )
+      {
+        std::cout << "** DistanceTable ** " << filename
+                  << " is not a valid table" << std::endl;
+        coef.clear();
+      }
+    return ok;
+  }
+
+  static const char* MAGIC() { return "QMULDMT1"; }
+
+  // Chebyshev node k of n in [-1, 1]
+  static double node(int k, int n)
+  {
+    return cos(M_PI * (k + 0.5) / n);
+  }
+
+  // Replace function values at Chebyshev nodes with the coefficients of
+  // the Chebyshev series along the middle axis of an array with shape
+  // (outer, n, inner).
+  static void transform(double* v, int outer, int n, int inner)
+  {
+    std::vector<double> f(n);
+    for(int o=0; o < outer; o++)
+      for(int i=0; i < inner; i++)
+        {
+          double* x = v + o*n*inner + i;
+          for(int k=0; k < n; k++) f[k] = x[k*inner];
+          for(int j=0; j < n; j++)
+            {
+              double sum = 0;
+              for(int k=0; k < n; k++)
+                sum += f[k] * cos(M_PI * j * (k + 0.5) / n);
+              x[j*inner] = (j == 0 ? 1.0 : 2.0) * sum / n;
+            }
+        }
+  }
+};
+
+#endif
@@ -0,0 +1,595 @@
+//-----------------------------------------------------------------------
+// File: dbexpfit.cc
+// Description: Compiled fitter for the double-exponential model of
+//              roofit.ipynb,
+//
+//                p(x|a, b, c) = [a exp(-x/b)/b + (1-a) exp(-x/c)/c] / I,
+//
+//              on the interval [xmin, xmax], where the normalization
+//
+//                I = a [exp(-xmin/b) - exp(-xmax/b)]
+//                  + (1-a) [exp(-xmin/c) - exp(-xmax/c)]
+//
+//              is computed analytically.
+//
+//              Unbinned fit: the negative log-likelihood and its
+//              gradient are summed in one pass over a contiguous array
+//              of events, which is split into blocks summed in parallel
+//              threads. The partial sums are combined in a fixed order,
+//              so the result does not depend on thread timing. Within a
+//              block, four events at a time are summed with AVX2, using
+//              polynomial exp and log accurate to about 1e-15; the AVX2
+//              kernel is selected at run time, with a scalar fallback.
+//
+//              The events may also be streamed, chunk by chunk, from a
+//              memory-mapped EventFile (see dbexpgen.h), in which case
+//              the chunks are summed in parallel and the sample is never
+//              held in memory as a whole. Each chunk is mapped once, by
+//              setFile, and stays mapped for all the NLL evaluations of
+//              a fit; its pages are read from the file as needed and can
+//              be dropped by the system under memory pressure.
+//
+//              Binned fit: the events (or externally supplied counts)
+//              are binned once and the multinomial negative log-
+//              likelihood uses the analytic bin integrals, as in
+//              RooFit's fit with Extended(False).
+//
+//              The minimization is done by Minuit through the
+//              ROOT::Math::Minimizer interface with analytic gradient.
+//
+// Created: Oct. 2026
+//-----------------------------------------------------------------------
+#ifndef DBEXPFIT_CC
+#define DBEXPFIT_CC
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TStopwatch.h"
+#include "Math/Minimizer.h"
+#include "Math/Factory.h"
+#include "Math/Functor.h"
+#include "dbexpgen.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define DBEXPFIT_AVX2
+#endif
+//-----------------------------------------------------------------------
+struct DBExpFit
+{
+  enum { NPAR = 3 };
+
+  const double* x;             // events (not owned)
+  long   n;                    // number of events
+  const EventFile* file;       // or file of events (not owned)
+  std::vector<double*> chunks; // its chunks, mapped by setFile
+  double xmin;
+  double xmax;
+  int    nthreads;
+
+  std::vector<double> counts;  // binned data on [xmin, xmax]
+
+  double par[NPAR];            // a, b, c: starting values, then results
+  double err[NPAR];
+  double cov[NPAR][NPAR];
+  double nllmin;
+  int    status;
+  int    ncall;
+  double realtime;             // seconds spent in last fit
+  bool   fitbinned;            // last fit was binned
+
+  std::string minimizer;
+  std::string algorithm;
+
+  // cache of last evaluation (Minuit asks for value and gradient
+  // separately)
+  double cachep[NPAR];
+  double cachef;
+  double cacheg[NPAR];
+
+  DBExpFit(double* _x=0, long _n=0,
+           double _xmin=0, double _xmax=20, int _nthreads=0)
+    : x(_x),
+      n(_n),
+      file(0),
+      chunks(),
+      xmin(_xmin),
+      xmax(_xmax),
+      nthreads(_nthreads > 0
+               ? _nthreads
+               : std::max(1, (int)std::thread::hardware_concurrency())),
+      counts(),
+      nllmin(0),
+      status(-1),
+      ncall(0),
+      realtime(0),
+      fitbinned(false),
+      minimizer("Minuit2"),
+      algorithm("Migrad"),
+      cachef(0)
+  {
+    setParameters(0.4, 3.0, 9.0);
+    for(int i=0; i < NPAR; i++) cachep[i] = NAN;
+  }
+
+  ~DBExpFit() { release(); }
+
+  DBExpFit(const DBExpFit&) = delete;
+  DBExpFit& operator=(const DBExpFit&) = delete;
+
+  // use the array x[0..n-1] (not copied; it must outlive the fitter)
+  void setData(double* _x, long _n)
+  {
+    release();
+    x = _x;
+    n = _n;
+    file = 0;
+    counts.clear();
+    invalidate();
+  }
+
+  // stream events from an open EventFile (it must outlive the fitter).
+  // Returns false, leaving no data, if a chunk cannot be mapped.
+  bool setFile(EventFile& f)
+  {
+    release();
+    x = 0;
+    n = 0;
+    counts.clear();
+    invalidate();
+    for(long long k=0; k < f.chunks(); k++)
+      {
+        double* y = f.map(k);
+        if ( !y )
+          {
+            std::cout << "** DBExpFit ** unable to map " << f.filename
+                      << std::endl;
+            file = &f;
+            release();
+            return false;
+          }
+        chunks.push_back(y);
+      }
+    n = f.size();
+    file = &f;
+    xmin = f.header.xmin;
+    xmax = f.header.xmax;
+    return true;
+  }
+
+  void setParameters(double a, double b, double c)
+  {
+    par[0] = a;
+    par[1] = b;
+    par[2] = c;
+    for(int i=0; i < NPAR; i++)
+      {
+        err[i] = 0;
+        for(int j=0; j < NPAR; j++) cov[i][j] = 0;
+      }
+  }
+
+  void setThreads(int nt) { nthreads = std::max(1, nt); }
+
+  // bin the events into nbins equal bins on [xmin, xmax]
+  void bin(int nbins)
+  {
+    counts.assign(nbins, 0);
+    if ( !file )
+      fill(x, n);
+    else
+      for(size_t k=0; k < chunks.size(); k++)
+        fill(chunks[k], file->chunkSize(k));
+    invalidate();
+  }
+
+  // use externally supplied counts in nbins equal bins on [xmin, xmax]
+  void setCounts(double* c, int nbins)
+  {
+    counts.assign(c, c + nbins);
+    invalidate();
+  }
+
+  //--------------------------------------------------------------------
+  // model
+  //--------------------------------------------------------------------
+  double density(double u, double a, double b, double c)
+  {
+    double I = a*E(xmin, b) + (1-a)*E(xmin, c)
+      - a*E(xmax, b) - (1-a)*E(xmax, c);
+    return (a*exp(-u/b)/b + (1-a)*exp(-u/c)/c) / I;
+  }
+
+  // exp(-u/s) and its derivative with respect to s
+  static double E(double u, double s)  { return exp(-u/s); }
+  static double dE(double u, double s) { return u/(s*s) * exp(-u/s); }
+
+  // Add -sum ln f(x) and its gradient over x[0..m-1] to s[0..3], where
+  // f = a exp(-x/b)/b + (1-a) exp(-x/c)/c is the unnormalized density
+  static void kernel(const double* x, long m,
+                     double a, double b, double c, double* s)
+  {
+#ifdef DBEXPFIT_AVX2
+    if ( avx2() )
+      {
+        long m4 = m - m % 4;
+        kernelAVX2(x, m4, a, b, c, s);
+        x += m4;
+        m -= m4;
+      }
+#endif
+    double ib = 1/b;
+    double ic = 1/c;
+    double wb = a*ib*ib;
+    double wc = (1-a)*ic*ic;
+    double s0 = 0;
+    double s1 = 0;
+    double s2 = 0;
+    double s3 = 0;
+    for(long i=0; i < m; i++)
+      {
+        double u  = x[i];
+        double g1 = exp(-u*ib)*ib;
+        double g2 = exp(-u*ic)*ic;
+        double f  = a*g1 + (1-a)*g2;
+        double r  = 1/f;
+        s0 -= log(f);
+        s1 -= (g1 - g2)*r;
+        s2 -= wb*g1*(u - b)*r;
+        s3 -= wc*g2*(u - c)*r;
+      }
+    s[0] += s0;
+    s[1] += s1;
+    s[2] += s2;
+    s[3] += s3;
+  }
+
+  // normalization integral over [lo, hi] and its gradient
+  static void integral(double lo, double hi, double a, double b, double c,
+                       double* I)
+  {
+    double Ib = E(lo, b) - E(hi, b);
+    double Ic = E(lo, c) - E(hi, c);
+    I[0] = a*Ib + (1-a)*Ic;
+    I[1] = Ib - Ic;
+    I[2] = a*(dE(lo, b) - dE(hi, b));
+    I[3] = (1-a)*(dE(lo, c) - dE(hi, c));
+  }
+
+  //--------------------------------------------------------------------
+  // negative log-likelihoods, with gradient in g[0..2]
+  //--------------------------------------------------------------------
+  double unbinnedNLL(const double* p, double* g)
+  {
+    double a = p[0];
+    double b = p[1];
+    double c = p[2];
+
+    if ( file ) return streamedNLL(p, g);
+
+    // sum over blocks of events in parallel
+    int nt = (int)std::min((long)nthreads, std::max(1L, n / 10000));
+    std::vector<double> s(4*nt, 0);
+    long block = (n + nt - 1) / nt;
+    if ( nt == 1 )
+      kernel(x, n, a, b, c, &s[0]);
+    else
+      {
+        std::vector<std::thread> pool;
+        for(int t=0; t < nt; t++)
+          {
+            long first = t * block;
+            long m = std::min(block, n - first);
+            if ( m <= 0 ) break;
+            pool.push_back(std::thread(kernel, x + first, m,
+                                       a, b, c, &s[4*t]));
+          }
+        for(size_t t=0; t < pool.size(); t++) pool[t].join();
+      }
+    double S[4] = {0, 0, 0, 0};
+    for(int t=0; t < nt; t++)
+      for(int k=0; k < 4; k++) S[k] += s[4*t+k];
+
+    double I[4];
+    integral(xmin, xmax, a, b, c, I);
+    for(int k=0; k < NPAR; k++) g[k] = S[k+1] + n*I[k+1]/I[0];
+    return S[0] + n*log(I[0]);
+  }
+
+  // as above, summing the chunks of the event file in parallel
+  double streamedNLL(const double* p, double* g)
+  {
+    double a = p[0];
+    double b = p[1];
+    double c = p[2];
+
+    long long nc = chunks.size();
+    int nt = (int)std::min((long long)nthreads, std::max(1LL, nc));
+    std::vector<double> s(4*nc, 0);
+    auto work = [&](int t)
+      {
+        for(long long k=t; k < nc; k += nt)
+          kernel(chunks[k], file->chunkSize(k), a, b, c, &s[4*k]);
+      };
+    if ( nt <= 1 )
+      work(0);
+    else
+      {
+        std::vector<std::thread> pool;
+        for(int t=0; t < nt; t++) pool.push_back(std::thread(work, t));
+        for(int t=0; t < nt; t++) pool[t].join();
+      }
+    double S[4] = {0, 0, 0, 0};
+    for(long long k=0; k < nc; k++)
+      for(int j=0; j < 4; j++) S[j] += s[4*k+j];
+
+    double I[4];
+    integral(xmin, xmax, a, b, c, I);
+    for(int k=0; k < NPAR; k++) g[k] = S[k+1] + n*I[k+1]/I[0];
+    return S[0] + n*log(I[0]);
+  }
+
+  double binnedNLL(const double* p, double* g)
+  {
+    double a = p[0];
+    double b = p[1];
+    double c = p[2];
+
+    double I[4];
+    integral(xmin, xmax, a, b, c, I);
+    int nbins = counts.size();
+    double step = (xmax - xmin) / nbins;
+    double total = 0;
+    double y = 0;
+    for(int k=0; k < NPAR; k++) g[k] = 0;
+    for(int i=0; i < nbins; i++)
+      {
+        total += counts[i];
+        if ( counts[i] <= 0 ) continue;
+        double J[4];
+        integral(xmin + i*step, xmin + (i+1)*step, a, b, c, J);
+        y -= counts[i] * log(J[0]);
+        for(int k=0; k < NPAR; k++) g[k] -= counts[i] * J[k+1] / J[0];
+      }
+    for(int k=0; k < NPAR; k++) g[k] += total * I[k+1] / I[0];
+    return y + total*log(I[0]);
+  }
+
+  double nll(const double* p)
+  {
+    update(p);
+    return cachef;
+  }
+
+  double derivative(const double* p, unsigned int k)
+  {
+    update(p);
+    return cacheg[k];
+  }
+
+  //--------------------------------------------------------------------
+  // unbinned fit, or binned fit (binned = true) of the counts set with
+  // bin or setCounts, which must be called first
+  //--------------------------------------------------------------------
+  bool fit(bool binned=false)
+  {
+    if ( binned && counts.size() == 0 )
+      {
+        std::cout << "** DBExpFit ** call bin(nbins) before a binned fit"
+                  << std::endl;
+        return false;
+      }
+    fitbinned = binned;
+    invalidate();
+
+    TStopwatch swatch;
+    swatch.Start();
+
+    ROOT::Math::Minimizer* minuit =
+      ROOT::Math::Factory::CreateMinimizer(minimizer, algorithm);
+    if ( !minuit )
+      {
+        std::cout << "** DBExpFit ** unable to create minimizer "
+                  << minimizer << std::endl;
+        return false;
+      }
+    ROOT::Math::GradFunctor fcn(this, &DBExpFit::nll,
+                                &DBExpFit::derivative, NPAR);
+    minuit->SetFunction(fcn);
+    minuit->SetErrorDef(0.5);
+    minuit->SetPrintLevel(-1);
+    minuit->SetLimitedVariable(0, "a", par[0], 0.01, 0.0,  1.0);
+    minuit->SetLimitedVariable(1, "b", par[1], 0.10, 0.01, 20.0);
+    minuit->SetLimitedVariable(2, "c", par[2], 0.10, 0.01, 20.0);
+
+    bool ok = minuit->Minimize();
+    minuit->Hesse();
+
+    const double* p = minuit->X();
+    const double* e = minuit->Errors();
+    for(int i=0; i < NPAR; i++)
+      {
+        par[i] = p[i];
+        err[i] = e[i];
+        for(int j=0; j < NPAR; j++) cov[i][j] = minuit->CovMatrix(i, j);
+      }
+    nllmin = minuit->MinValue();
+    status = minuit->Status();
+    ncall  = minuit->NCalls();
+    delete minuit;
+
+    realtime = swatch.RealTime();
+    return ok;
+  }
+
+  double value(int i) const { return par[i]; }
+  double error(int i) const { return err[i]; }
+  double correlation(int i, int j) const
+  {
+    return cov[i][j] / sqrt(cov[i][i]*cov[j][j]);
+  }
+
+  void summary() const
+  {
+    const char* name[NPAR] = {"a", "b", "c"};
+    char record[120];
+    sprintf(record, "DBExpFit: %s fit to %ld events, status %d, "
+            "%d calls, %.3f s", fitbinned ? "binned" : "unbinned",
+            n, status, ncall, realtime);
+    std::cout << record << std::endl;
+    for(int i=0; i < NPAR; i++)
+      {
+        sprintf(record, "%10s %10.4f +/- %-10.4f", name[i], par[i], err[i]);
+        std::cout << record << std::endl;
+      }
+  }
+
+private:
+  void invalidate() { cachep[0] = NAN; }
+
+  // unmap the chunks of the event file, if any
+  void release()
+  {
+    for(size_t k=0; k < chunks.size(); k++) file->unmap(chunks[k], k);
+    chunks.clear();
+    file = 0;
+  }
+
+#ifdef DBEXPFIT_AVX2
+  static bool avx2()
+  {
+    static const bool yes = __builtin_cpu_supports("avx2") &&
+      __builtin_cpu_supports("fma");
+    return yes;
+  }
+
+  // exp(x) = 2^k exp(r), with x = k ln 2 + r and |r| <= ln 2 / 2, and
+  // exp(r) from its Taylor series to r^12. Zero below -708.
+  __attribute__((target("avx2,fma")))
+  static __m256d expAVX2(__m256d x)
+  {
+    const __m256d xlo = _mm256_set1_pd(-708.0);
+    __m256d zero = _mm256_cmp_pd(x, xlo, _CMP_LT_OQ);
+    x = _mm256_min_pd(_mm256_max_pd(x, xlo), _mm256_set1_pd(709.0));
+    __m256d k = _mm256_round_pd(_mm256_mul_pd(x,
+                                              _mm256_set1_pd(M_LOG2E)),
+                                _MM_FROUND_TO_NEAREST_INT |
+                                _MM_FROUND_NO_EXC);
+    __m256d r = _mm256_fnmadd_pd(k, _mm256_set1_pd(6.93147180369123816490e-01),
+                                 x);
+    r = _mm256_fnmadd_pd(k, _mm256_set1_pd(1.90821492927058770002e-10), r);
+    double term[13];
+    term[0] = 1;
+    for(int j=1; j < 13; j++) term[j] = term[j-1] / j;
+    __m256d p = _mm256_set1_pd(term[12]);
+    for(int j=11; j >= 0; j--)
+      p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(term[j]));
+    __m256i e = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(k));
+    e = _mm256_slli_epi64(_mm256_add_epi64(e, _mm256_set1_epi64x(1023)), 52);
+    return _mm256_andnot_pd(zero, _mm256_mul_pd(p, _mm256_castsi256_pd(e)));
+  }
+
+  // ln(f) = e ln 2 + ln(m) for f = 2^e m with m in [sqrt(1/2), sqrt(2)),
+  // and ln(m) = 2 atanh(s), s = (m-1)/(m+1), from its series to s^21.
+  // f must be positive and normal.
+  __attribute__((target("avx2,fma")))
+  static __m256d logAVX2(__m256d f)
+  {
+    __m256i bits = _mm256_castpd_si256(f);
+    // biased exponent as a double: (2^52 + e) - 2^52
+    __m256i eb = _mm256_or_si256(_mm256_srli_epi64(bits, 52),
+                                 _mm256_set1_epi64x(0x4330000000000000LL));
+    __m256d e = _mm256_sub_pd(_mm256_castsi256_pd(eb),
+                              _mm256_set1_pd(4503599627370496.0 + 1023));
+    __m256i mb = _mm256_or_si256(
+      _mm256_and_si256(bits, _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+      _mm256_set1_epi64x(0x3FF0000000000000LL));
+    __m256d m = _mm256_castsi256_pd(mb);
+    __m256d big = _mm256_cmp_pd(m, _mm256_set1_pd(M_SQRT2), _CMP_GT_OQ);
+    m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), big);
+    e = _mm256_add_pd(e, _mm256_and_pd(big, _mm256_set1_pd(1.0)));
+
+    const __m256d one = _mm256_set1_pd(1.0);
+    __m256d t  = _mm256_div_pd(_mm256_sub_pd(m, one), _mm256_add_pd(m, one));
+    __m256d t2 = _mm256_mul_pd(t, t);
+    __m256d p  = _mm256_set1_pd(1.0/21);
+    for(int j=19; j >= 1; j -= 2)
+      p = _mm256_fmadd_pd(p, t2, _mm256_set1_pd(1.0/j));
+    __m256d y = _mm256_mul_pd(_mm256_add_pd(t, t), p);
+    y = _mm256_fmadd_pd(e, _mm256_set1_pd(1.90821492927058770002e-10), y);
+    return _mm256_fmadd_pd(e, _mm256_set1_pd(6.93147180369123816490e-01), y);
+  }
+
+  // kernel for m a multiple of 4
+  __attribute__((target("avx2,fma")))
+  static void kernelAVX2(const double* x, long m,
+                         double a, double b, double c, double* s)
+  {
+    const __m256d A  = _mm256_set1_pd(a);
+    const __m256d A1 = _mm256_set1_pd(1-a);
+    const __m256d B  = _mm256_set1_pd(b);
+    const __m256d C  = _mm256_set1_pd(c);
+    const __m256d IB = _mm256_set1_pd(1/b);
+    const __m256d IC = _mm256_set1_pd(1/c);
+    const __m256d WB = _mm256_set1_pd(a/(b*b));
+    const __m256d WC = _mm256_set1_pd((1-a)/(c*c));
+    const __m256d one = _mm256_set1_pd(1.0);
+    __m256d s0 = _mm256_setzero_pd();
+    __m256d s1 = _mm256_setzero_pd();
+    __m256d s2 = _mm256_setzero_pd();
+    __m256d s3 = _mm256_setzero_pd();
+    for(long i=0; i < m; i += 4)
+      {
+        __m256d u  = _mm256_loadu_pd(x + i);
+        __m256d g1 = _mm256_mul_pd(expAVX2(_mm256_mul_pd(
+                                     _mm256_sub_pd(_mm256_setzero_pd(), u),
+                                     IB)), IB);
+        __m256d g2 = _mm256_mul_pd(expAVX2(_mm256_mul_pd(
+                                     _mm256_sub_pd(_mm256_setzero_pd(), u),
+                                     IC)), IC);
+        __m256d f  = _mm256_fmadd_pd(A, g1, _mm256_mul_pd(A1, g2));
+        __m256d r  = _mm256_div_pd(one, f);
+        s0 = _mm256_sub_pd(s0, logAVX2(f));
+        s1 = _mm256_fnmadd_pd(_mm256_sub_pd(g1, g2), r, s1);
+        s2 = _mm256_fnmadd_pd(_mm256_mul_pd(WB, g1),
+                              _mm256_mul_pd(_mm256_sub_pd(u, B), r), s2);
+        s3 = _mm256_fnmadd_pd(_mm256_mul_pd(WC, g2),
+                              _mm256_mul_pd(_mm256_sub_pd(u, C), r), s3);
+      }
+    double y[4];
+    _mm256_storeu_pd(y, s0); s[0] += (y[0] + y[1]) + (y[2] + y[3]);
+    _mm256_storeu_pd(y, s1); s[1] += (y[0] + y[1]) + (y[2] + y[3]);
+    _mm256_storeu_pd(y, s2); s[2] += (y[0] + y[1]) + (y[2] + y[3]);
+    _mm256_storeu_pd(y, s3); s[3] += (y[0] + y[1]) + (y[2] + y[3]);
+  }
+#endif
+
+  // add events y[0..m-1] to counts
+  void fill(const double* y, long long m)
+  {
+    int nbins = counts.size();
+    double scale = nbins / (xmax - xmin);
+    for(long long i=0; i < m; i++)
+      {
+        double u = floor((y[i] - xmin) * scale);
+        if ( u >= 0 && u < nbins ) counts[(int)u]++;
+        else if ( y[i] == xmax ) counts[nbins-1]++;
+      }
+  }
+
+  void update(const double* p)
+  {
+    if ( p[0] == cachep[0] && p[1] == cachep[1] && p[2] == cachep[2] )
+      return;
+    cachef = fitbinned ? binnedNLL(p, cacheg) : unbinnedNLL(p, cacheg);
+    for(int i=0; i < NPAR; i++) cachep[i] = p[i];
+  }
+};
+
+#endif
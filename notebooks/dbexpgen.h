@@ -0,0 +1,324 @@
+#ifndef DBEXPGEN_H
+#define DBEXPGEN_H
+//-----------------------------------------------------------------------
+// File: dbexpgen.h
+// Description: Parallel, out-of-core generation of events from the
+//              double-exponential model of roofit.ipynb,
+//
+//                p(x|a, b, c) ~ a exp(-x/b)/b + (1-a) exp(-x/c)/c,
+//
+//              on [xmin, xmax].
+//
+//              Each event is drawn by inverse-CDF sampling: a component
+//              is chosen with probability proportional to its mass on
+//              [xmin, xmax], then x is drawn from that truncated
+//              exponential in closed form. No events are rejected.
+//
+//              Events are organized in fixed-size chunks. Chunk k is
+//              generated from its own random number stream, seeded by
+//              (seed, k), so a sample is reproducible whatever the
+//              number of threads. Uniform variates are made directly
+//              from the 64-bit engine output so that they do not depend
+//              on the standard library implementation.
+//
+//              EventFile is a flat binary file: a 4096-byte header
+//              followed by the events as doubles. Chunks start on
+//              4096-byte boundaries and are memory-mapped one at a time,
+//              both when they are written and when they are read, so
+//              that samples much larger than the available memory can be
+//              generated and fitted (see DBExpFit::setFile). A mapping
+//              starts at the page boundary at or below its chunk, so the
+//              file works with any page size.
+//
+// Created: Oct. 2026
+//-----------------------------------------------------------------------
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+//-----------------------------------------------------------------------
+struct EventFile
+{
+  enum { HEADERSIZE = 4096, ALIGN = 512 };   // ALIGN doubles = 4096 bytes
+
+  struct Header
+  {
+    char   magic[8];
+    long long nevents;
+    long long chunksize;
+    double xmin;
+    double xmax;
+    double par[3];
+    unsigned long long seed;
+  };
+
+  std::string filename;
+  int    fd;
+  bool   writable;
+  Header header;
+
+  EventFile() : filename(""), fd(-1), writable(false)
+  {
+    memset(&header, 0, sizeof(header));
+  }
+
+  EventFile(std::string name) : filename(""), fd(-1), writable(false)
+  {
+    memset(&header, 0, sizeof(header));
+    open(name);
+  }
+
+  ~EventFile() { close(); }
+
+  EventFile(const EventFile&) = delete;
+  EventFile& operator=(const EventFile&) = delete;
+
+  // create a file for nevents events, in chunks of chunksize events
+  // (rounded up to a multiple of ALIGN)
+  bool create(std::string name, long long nevents, long long chunksize,
+              double xmin, double xmax, const double* par,
+              unsigned long long seed)
+  {
+    close();
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC(), 8);
+    header.nevents   = nevents;
+    header.chunksize = ALIGN * ((std::max(1LL, chunksize) + ALIGN-1) / ALIGN);
+    header.xmin = xmin;
+    header.xmax = xmax;
+    for(int i=0; i < 3; i++) header.par[i] = par[i];
+    header.seed = seed;
+
+    fd = ::open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if ( fd < 0 )
+      {
+        std::cout << "** EventFile ** unable to create " << name
+                  << std::endl;
+        return false;
+      }
+    char block[HEADERSIZE];
+    memset(block, 0, HEADERSIZE);
+    memcpy(block, &header, sizeof(header));
+    bool ok = ::write(fd, block, HEADERSIZE) == HEADERSIZE &&
+      ftruncate(fd, HEADERSIZE + nevents*(off_t)sizeof(double)) == 0;
+    if ( !ok )
+      {
+        std::cout << "** EventFile ** unable to size " << name << std::endl;
+        close();
+        return false;
+      }
+    filename = name;
+    writable = true;
+    return true;
+  }
+
+  bool open(std::string name)
+  {
+    close();
+    fd = ::open(name.c_str(), O_RDONLY);
+    if ( fd < 0 ) return false;
+    bool ok = ::read(fd, &header, sizeof(header)) == sizeof(header) &&
+      memcmp(header.magic, MAGIC(), 8) == 0 &&
+      header.nevents >= 0 &&
+      header.chunksize > 0 &&
+      header.chunksize % ALIGN == 0;
+
+    // the events declared must be in the file, else mapping them would
+    // fault (SIGBUS) past its end
+    struct stat st;
+    ok = ok && fstat(fd, &st) == 0 &&
+      header.nevents <= (st.st_size - HEADERSIZE) / (off_t)sizeof(double);
+    if ( !ok )
+      {
+        std::cout << "** EventFile ** " << name << " is not an event file"
+                  << std::endl;
+        close();
+        return false;
+      }
+    filename = name;
+    writable = false;
+    return true;
+  }
+
+  void close()
+  {
+    if ( fd >= 0 ) ::close(fd);
+    fd = -1;
+  }
+
+  bool good() const { return fd >= 0; }
+
+  long long size() const { return header.nevents; }
+
+  long long chunks() const
+  {
+    return (header.nevents + header.chunksize - 1) / header.chunksize;
+  }
+
+  // number of events in chunk k
+  long long chunkSize(long long k) const
+  {
+    return std::min(header.chunksize, header.nevents - k*header.chunksize);
+  }
+
+  // map chunk k into memory; release with unmap
+  double* map(long long k) const
+  {
+    off_t  offset = HEADERSIZE + k*header.chunksize*(off_t)sizeof(double);
+    off_t  pad    = offset % pageSize();
+    size_t bytes  = pad + chunkSize(k) * sizeof(double);
+    void* p = mmap(0, bytes,
+                   writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                   MAP_SHARED, fd, offset - pad);
+    if ( p == MAP_FAILED ) return 0;
+    if ( !writable ) madvise(p, bytes, MADV_SEQUENTIAL);
+    return reinterpret_cast<double*>(static_cast<char*>(p) + pad);
+  }
+
+  void unmap(double* x, long long k) const
+  {
+    off_t offset = HEADERSIZE + k*header.chunksize*(off_t)sizeof(double);
+    off_t pad    = offset % pageSize();
+    munmap(reinterpret_cast<char*>(x) - pad,
+           pad + chunkSize(k) * sizeof(double));
+  }
+
+  // mmap offsets must be multiples of the page size, which can exceed
+  // 4096 bytes (e.g., 16 kB or 64 kB on arm64 and ppc64le)
+  static off_t pageSize()
+  {
+    static const off_t size = sysconf(_SC_PAGESIZE);
+    return size;
+  }
+
+  static const char* MAGIC() { return "QMULEVT1"; }
+};
+
+//-----------------------------------------------------------------------
+struct DBExpGenerator
+{
+  double a;
+  double b;
+  double c;
+  double xmin;
+  double xmax;
+  unsigned long long seed;
+  int    nthreads;
+
+  DBExpGenerator(double _a=0.4, double _b=3.0, double _c=9.0,
+                 double _xmin=0, double _xmax=20,
+                 unsigned long long _seed=1, int _nthreads=0)
+    : a(_a),
+      b(_b),
+      c(_c),
+      xmin(_xmin),
+      xmax(_xmax),
+      seed(_seed),
+      nthreads(_nthreads > 0
+               ? _nthreads
+               : std::max(1, (int)std::thread::hardware_concurrency()))
+  {}
+
+  ~DBExpGenerator() {}
+
+  // seed of stream k
+  unsigned long long stream(long long k) const
+  {
+    unsigned long long x = seed + 0x9E3779B97F4A7C15ULL * (k + 1);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+  }
+
+  // fill x[0..m-1] with the events of chunk k
+  void fill(double* x, long long m, long long k) const
+  {
+    const double scale = 1.0 / 9007199254740992.0;   // 2^-53
+    double Eb0 = exp(-xmin/b);
+    double Eb1 = exp(-xmax/b);
+    double Ec0 = exp(-xmin/c);
+    double Ec1 = exp(-xmax/c);
+    double wb  = a*(Eb0 - Eb1);
+    double fb  = wb / (wb + (1-a)*(Ec0 - Ec1));   // mass of component b
+
+    std::mt19937_64 rng(stream(k));
+    for(long long i=0; i < m; i++)
+      {
+        double u = (rng() >> 11) * scale;
+        double v = (rng() >> 11) * scale;
+        x[i] = u < fb
+          ? -b * log(Eb0 - v*(Eb0 - Eb1))
+          : -c * log(Ec0 - v*(Ec0 - Ec1));
+      }
+  }
+
+  // generate n events into memory, using the same chunks as a file
+  // written with the same chunk size
+  void generate(double* x, long long n, long long chunksize=1<<20)
+  {
+    chunksize = EventFile::ALIGN *
+      ((std::max(1LL, chunksize) + EventFile::ALIGN-1) / EventFile::ALIGN);
+    long long nchunks = (n + chunksize - 1) / chunksize;
+    run(nchunks, [&](long long k)
+        {
+          fill(x + k*chunksize, std::min(chunksize, n - k*chunksize), k);
+          return true;
+        });
+  }
+
+  // generate n events directly into the memory-mapped file filename
+  bool generate(std::string filename, long long n,
+                long long chunksize=1<<20)
+  {
+    double par[3] = {a, b, c};
+    EventFile file;
+    if ( !file.create(filename, n, chunksize, xmin, xmax, par, seed) )
+      return false;
+    bool ok = run(file.chunks(), [&](long long k)
+                  {
+                    double* x = file.map(k);
+                    if ( !x ) return false;
+                    fill(x, file.chunkSize(k), k);
+                    file.unmap(x, k);
+                    return true;
+                  });
+    if ( !ok )
+      std::cout << "** DBExpGenerator ** unable to map " << filename
+                << std::endl;
+    return ok;
+  }
+
+private:
+  // apply task to chunks 0..nchunks-1, chunk k in thread k % nthreads
+  template <class Task>
+  bool run(long long nchunks, Task task)
+  {
+    int nt = (int)std::min((long long)nthreads, std::max(1LL, nchunks));
+    std::vector<char> ok(nt, 1);
+    auto work = [&](int t)
+      {
+        for(long long k=t; k < nchunks; k += nt)
+          if ( !task(k) ) ok[t] = 0;
+      };
+    if ( nt == 1 )
+      work(0);
+    else
+      {
+        std::vector<std::thread> pool;
+        for(int t=0; t < nt; t++) pool.push_back(std::thread(work, t));
+        for(int t=0; t < nt; t++) pool[t].join();
+      }
+    return std::find(ok.begin(), ok.end(), 0) == ok.end();
+  }
+};
+
+#endif
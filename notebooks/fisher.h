@@ -0,0 +1,325 @@
+#ifndef FISHER_H
+#define FISHER_H
+//-----------------------------------------------------------------------
+// File: fisher.h
+// Description: Fisher-matrix forecasts of the parameter errors of a
+//              CosmicCode model for hypothetical supernova surveys.
+//
+//              A survey design is a set of n redshift bins z_k, each
+//              with count_k objects of per-object error sigma_k and an
+//              optional systematic floor f_k, which does not average
+//              down with the number of objects. The variance of the
+//              mean distance modulus of bin k is
+//
+//                V_k = sigma_k^2 / count_k + f_k^2,
+//
+//              and the Fisher matrix of the model parameters p is
+//
+//                F_ij = sum_k dmu/dp_i(z_k) dmu/dp_j(z_k) / V_k.
+//
+//              The derivatives depend only on the fiducial point and z,
+//              not on the design, so they are computed once on a uniform
+//              grid in z (central differences of distanceModulus,
+//              directly from the quadrature, and exactly for H0) and
+//              interpolated. At z = 0, where mu itself is singular, the
+//              grid holds the limits: dmu/dp = 0 for the parameters
+//              other than H0, which enter only through the reduced
+//              modulus, finite and parameter-free at z = 0.
+//              A design then costs O(n ndim^2), and batches of designs
+//              are shared among threads.
+//
+//              Gaussian priors on individual parameters can be added to
+//              every design with setPrior.
+//
+// Created: Oct. 2026
+//-----------------------------------------------------------------------
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "cosmiccode.cc"
+//-----------------------------------------------------------------------
+struct FisherForecast
+{
+  enum { MAXDIM = DistanceTable::MAXDIM+1 };
+
+  CosmicCode& code;
+  int    ndim;
+  int    nthreads;
+  double p[MAXDIM];              // fiducial point
+  double prior[MAXDIM];          // Gaussian prior widths (0 = none)
+  double step;                   // relative step of the derivatives
+  std::vector<double> zgrid;
+  std::vector<double> dmu;       // dmu[k*ndim + i] = dmu/dp_i at zgrid[k]
+
+  FisherForecast(CosmicCode& _code, double* fiducial, double zmax=2,
+                 int nz=400, int _nthreads=0)
+    : code(_code),
+      ndim(_code.model.size()),
+      nthreads(_nthreads > 0
+               ? _nthreads
+               : std::max(1, (int)std::thread::hardware_concurrency())),
+      step(1.e-4),
+      zgrid(),
+      dmu()
+  {
+    for(int i=0; i < MAXDIM; i++) prior[i] = 0;
+    if ( !setFiducial(fiducial, zmax, nz) )
+      std::cout << "** FisherForecast ** invalid fiducial point" << std::endl;
+  }
+
+  ~FisherForecast() {}
+
+  // Set the fiducial point and tabulate the derivatives on nz points
+  // spanning [0, zmax]. Returns false, leaving the derivatives unset,
+  // if the point is not valid for the model. The table of code is
+  // switched off while the derivatives are computed, so this must not
+  // run while code is used elsewhere (e.g., in another thread).
+  bool setFiducial(double* fiducial, double zmax=2, int nz=400)
+  {
+    if ( !code.model.valid(fiducial) || !(zmax > 0) )
+      {
+        zgrid.clear();
+        dmu.clear();
+        return false;
+      }
+    for(int i=0; i < ndim; i++) p[i] = fiducial[i];
+    nz = std::max(2, nz);
+    zgrid.resize(nz);
+    dmu.resize(nz*ndim);
+
+    // differentiate the quadrature, not the table, whose patches are
+    // only continuous to within their estimated error
+    bool usetable = code.usetable;
+    if ( usetable ) code.useTable(false);
+    int h = code.model.h0index();
+    for(int k=0; k < nz; k++)
+      {
+        zgrid[k] = zmax * k / (nz-1);
+        if ( k > 0 )
+          derivatives(zgrid[k], &dmu[k*ndim]);
+        else
+          for(int i=0; i < ndim; i++)
+            dmu[i] = i == h ? -5 / (log(10.0) * p[h]) : 0;
+      }
+    if ( usetable ) code.useTable(true);
+
+    for(int i=0; i < nz*ndim; i++)
+      if ( std::isnan(dmu[i]) )
+        {
+          zgrid.clear();
+          dmu.clear();
+          return false;
+        }
+    return true;
+  }
+
+  // Gaussian prior of width sigma on parameter i (0 removes it)
+  void setPrior(int i, double sigma)
+  {
+    if ( i >= 0 && i < ndim ) prior[i] = sigma;
+  }
+
+  // interpolated derivatives of mu at z (NAN without a valid fiducial
+  // point)
+  void gradient(double z, double* d) const
+  {
+    int nz = zgrid.size();
+    if ( nz < 2 )
+      {
+        for(int i=0; i < ndim; i++) d[i] = NAN;
+        return;
+      }
+    double h = zgrid[nz-1] / (nz-1);
+    int k = std::min(nz-2, std::max(0, (int)(z / h)));
+    double t = (z - zgrid[k]) / (zgrid[k+1] - zgrid[k]);
+    for(int i=0; i < ndim; i++)
+      d[i] = (1-t)*dmu[k*ndim+i] + t*dmu[(k+1)*ndim+i];
+  }
+
+  // Fisher matrix F (ndim x ndim, row by row) of a design of n bins.
+  // count and floor may be zero, meaning one object per bin and no
+  // floor.
+  void fisher(double* z, double* count, double* sigma, double* floor,
+              int n, double* F) const
+  {
+    for(int i=0; i < ndim*ndim; i++) F[i] = 0;
+    double d[MAXDIM];
+    for(int k=0; k < n; k++)
+      {
+        double N = count ? count[k] : 1;
+        if ( !(N > 0) ) continue;
+        double V = sigma[k]*sigma[k] / N;
+        if ( floor ) V += floor[k]*floor[k];
+        if ( !(V > 0) ) continue;
+        gradient(z[k], d);
+        for(int i=0; i < ndim; i++)
+          for(int j=0; j <= i; j++)
+            F[i*ndim+j] += d[i]*d[j] / V;
+      }
+    for(int i=0; i < ndim; i++)
+      {
+        if ( prior[i] > 0 ) F[i*ndim+i] += 1 / (prior[i]*prior[i]);
+        for(int j=0; j < i; j++) F[j*ndim+i] = F[i*ndim+j];
+      }
+  }
+
+  // marginalized errors err and, if given, the covariance matrix C of
+  // a design. Returns false if the Fisher matrix is singular.
+  bool errors(double* z, double* count, double* sigma, double* floor,
+              int n, double* err, double* C=0) const
+  {
+    double F[MAXDIM*MAXDIM];
+    double V[MAXDIM*MAXDIM];
+    fisher(z, count, sigma, floor, n, F);
+    bool ok = invert(F, V);
+    for(int i=0; i < ndim; i++) err[i] = ok ? sqrt(V[i*ndim+i]) : NAN;
+    if ( C ) for(int i=0; i < ndim*ndim; i++) C[i] = ok ? V[i] : NAN;
+    return ok;
+  }
+
+  // Forecast ndesign designs of n bins each. count, sigma and floor
+  // hold the designs row by row (ndesign x n); z is either shared (one
+  // row) or given per design (ndesign rows, zrows = true). count and
+  // floor may be zero. The marginalized errors are returned in err
+  // (ndesign x ndim) and, if given, a figure of merit in fom: the
+  // inverse square root of the determinant of the covariance of the
+  // parameters other than H0.
+  void forecast(int ndesign, int n,
+                double* z,
+                double* count,
+                double* sigma,
+                double* floor,
+                double* err,
+                double* fom=0,
+                bool zrows=false) const
+  {
+    int h  = code.model.h0index();
+    int nt = std::min(nthreads, std::max(1, ndesign));
+    auto work = [&](int t)
+      {
+        double V[MAXDIM*MAXDIM];
+        for(int m=t; m < ndesign; m += nt)
+          {
+            size_t o = (size_t)m*n;
+            bool ok = errors(zrows ? z + o : z,
+                             count ? count + o : 0,
+                             sigma + o,
+                             floor ? floor + o : 0,
+                             n, err + (size_t)m*ndim, V);
+            if ( !fom ) continue;
+            if ( !ok )
+              {
+                fom[m] = 0;
+                continue;
+              }
+            // determinant of the covariance with H0 removed
+            double R[MAXDIM*MAXDIM];
+            int r = 0;
+            for(int i=0; i < ndim; i++)
+              {
+                if ( i == h ) continue;
+                int c = 0;
+                for(int j=0; j < ndim; j++)
+                  if ( j != h ) R[r*(ndim-1) + c++] = V[i*ndim+j];
+                r++;
+              }
+            double det = determinant(R, ndim-1);
+            fom[m] = det > 0 ? 1/sqrt(det) : 0;
+          }
+      };
+    run(work, nt);
+  }
+
+private:
+  // dmu/dp_i at z for the fiducial point
+  void derivatives(double z, double* d)
+  {
+    int h = code.model.h0index();
+    double q[MAXDIM];
+    for(int i=0; i < ndim; i++)
+      {
+        if ( i == h )
+          {
+            d[i] = -5 / (log(10.0) * p[h]);
+            continue;
+          }
+        for(int j=0; j < ndim; j++) q[j] = p[j];
+        double e = step * std::max(fabs(p[i]), 0.01);
+        q[i] = p[i] + e;
+        double up = code.model.valid(q) ? code.distanceModulus(z, q) : NAN;
+        q[i] = p[i] - e;
+        double dn = code.model.valid(q) ? code.distanceModulus(z, q) : NAN;
+        double mu = code.distanceModulus(z, p);
+        if ( std::isnan(up) )
+          d[i] = (mu - dn) / e;
+        else if ( std::isnan(dn) )
+          d[i] = (up - mu) / e;
+        else
+          d[i] = (up - dn) / (2*e);
+      }
+  }
+
+  // inverse of a symmetric positive definite matrix by Cholesky
+  bool invert(double* A, double* Ainv) const
+  {
+    int n = ndim;
+    double L[MAXDIM*MAXDIM];
+    for(int i=0; i < n; i++)
+      for(int j=0; j <= i; j++)
+        {
+          double s = A[i*n+j];
+          for(int k=0; k < j; k++) s -= L[i*n+k]*L[j*n+k];
+          if ( i == j )
+            {
+              if ( !(s > 0) ) return false;
+              L[i*n+i] = sqrt(s);
+            }
+          else
+            L[i*n+j] = s / L[j*n+j];
+        }
+    // solve L L^T x = e_c for each column c
+    for(int c=0; c < n; c++)
+      {
+        double y[MAXDIM];
+        for(int i=0; i < n; i++)
+          {
+            double s = i == c ? 1 : 0;
+            for(int k=0; k < i; k++) s -= L[i*n+k]*y[k];
+            y[i] = s / L[i*n+i];
+          }
+        for(int i=n-1; i >= 0; i--)
+          {
+            double s = y[i];
+            for(int k=i+1; k < n; k++) s -= L[k*n+i]*Ainv[k*n+c];
+            Ainv[i*n+c] = s / L[i*n+i];
+          }
+      }
+    return true;
+  }
+
+  static double determinant(double* A, int n)
+  {
+    if ( n == 1 ) return A[0];
+    if ( n == 2 ) return A[0]*A[3] - A[1]*A[2];
+    return A[0]*(A[4]*A[8] - A[5]*A[7])
+      - A[1]*(A[3]*A[8] - A[5]*A[6])
+      + A[2]*(A[3]*A[7] - A[4]*A[6]);
+  }
+
+  template <class Task>
+  static void run(Task& work, int nt)
+  {
+    if ( nt == 1 )
+      {
+        work(0);
+        return;
+      }
+    std::vector<std::thread> pool;
+    for(int t=0; t < nt; t++) pool.push_back(std::thread(work, t));
+    for(int t=0; t < nt; t++) pool[t].join();
+  }
+};
+
+#endif
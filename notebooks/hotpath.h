@@ -0,0 +1,250 @@
+#ifndef HOTPATH_H
+#define HOTPATH_H
+//-----------------------------------------------------------------------
+// File: hotpath.h
+// Description: Low-overhead counters and timers for the hot paths of
+//              study.cc and cosmiccode.cc: integrand evaluations,
+//              integrals, root-finder iterations and failures, and
+//              likelihood calls.
+//
+//              Instrumentation is off by default. When off, each probe
+//              costs one relaxed atomic load and a branch, so it can be
+//              left in production builds. It is switched on with
+//              hotpath::enable() or by setting the environment variable
+//              HOTPATH, in which case a summary is also printed at exit.
+//
+//              Each thread accumulates into its own slot, which only
+//              that thread writes, so no locking or read-modify-write
+//              atomics are needed. snapshot() adds up the live slots
+//              and the totals of threads that have exited.
+//
+//              Usage:
+//                hotpath::count(hotpath::INTEGRAND);
+//                { hotpath::Timer t(hotpath::INTEGRAL); ... }
+//                hotpath::Snapshot s = hotpath::snapshot();
+//
+// Created: Oct. 2026
+//-----------------------------------------------------------------------
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <vector>
+//-----------------------------------------------------------------------
+namespace hotpath
+{
+  enum Counter
+    {
+      INTEGRAND=0,      // integrand evaluations (adaptive integrals)
+      INTEGRAL,         // calls to IntegratorOneDim::Integral
+      ROOTSOLVE,        // calls to RootFinder::Solve
+      ROOTITERATION,    // root-finder iterations
+      ROOTFAILURE,      // root-finder failures
+      LIKELIHOOD,       // likelihood evaluations
+      QUADRATURE,       // points of the distance-modulus quadrature
+      NCOUNTERS
+    };
+
+  inline const char* name(int i)
+  {
+    static const char* names[NCOUNTERS] =
+      {"integrand", "integral", "root solve", "root iteration",
+       "root failure", "likelihood", "quadrature"};
+    return i >= 0 && i < NCOUNTERS ? names[i] : "";
+  }
+
+  struct Snapshot
+  {
+    unsigned long long count[NCOUNTERS];
+    double seconds[NCOUNTERS];   // time spent, for timed counters
+
+    Snapshot()
+    {
+      for(int i=0; i < NCOUNTERS; i++)
+        {
+          count[i] = 0;
+          seconds[i] = 0;
+        }
+    }
+
+    // accessors for Python
+    double counts(int i) const { return count[i]; }
+    double time(int i) const   { return seconds[i]; }
+  };
+
+  // per-thread slot; written only by its own thread
+  struct Slot
+  {
+    std::atomic<unsigned long long> count[NCOUNTERS];
+    std::atomic<unsigned long long> nanos[NCOUNTERS];
+
+    Slot();
+    ~Slot();
+
+    void add(int i, unsigned long long n)
+    {
+      count[i].store(count[i].load(std::memory_order_relaxed) + n,
+                     std::memory_order_relaxed);
+    }
+    void addTime(int i, unsigned long long ns)
+    {
+      nanos[i].store(nanos[i].load(std::memory_order_relaxed) + ns,
+                     std::memory_order_relaxed);
+    }
+  };
+
+  struct Registry
+  {
+    std::mutex lock;
+    std::vector<Slot*> slots;
+    Snapshot retired;            // totals of threads that have exited
+  };
+
+  inline Registry& registry()
+  {
+    static Registry* r = new Registry();   // never destroyed
+    return *r;
+  }
+
+  inline std::atomic<bool>& flag()
+  {
+    static std::atomic<bool> on(false);
+    return on;
+  }
+
+  inline bool enabled() { return flag().load(std::memory_order_relaxed); }
+
+  inline Slot::Slot()
+  {
+    for(int i=0; i < NCOUNTERS; i++)
+      {
+        count[i].store(0);
+        nanos[i].store(0);
+      }
+    Registry& r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    r.slots.push_back(this);
+  }
+
+  inline Slot::~Slot()
+  {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    for(int i=0; i < NCOUNTERS; i++)
+      {
+        r.retired.count[i]   += count[i].load();
+        r.retired.seconds[i] += 1.e-9 * nanos[i].load();
+      }
+    for(size_t i=0; i < r.slots.size(); i++)
+      if ( r.slots[i] == this )
+        {
+          r.slots.erase(r.slots.begin() + i);
+          break;
+        }
+  }
+
+  inline Slot& local()
+  {
+    static thread_local Slot slot;
+    return slot;
+  }
+
+  inline void count(Counter i, unsigned long long n=1)
+  {
+    if ( enabled() ) local().add(i, n);
+  }
+
+  // count a call and time it
+  struct Timer
+  {
+    int which;
+    std::chrono::steady_clock::time_point start;
+
+    Timer(Counter i) : which(enabled() ? i : -1)
+    {
+      if ( which >= 0 ) start = std::chrono::steady_clock::now();
+    }
+
+    ~Timer()
+    {
+      if ( which < 0 ) return;
+      unsigned long long ns = std::chrono::duration_cast<
+        std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                  start).count();
+      Slot& s = local();
+      s.add(which, 1);
+      s.addTime(which, ns);
+    }
+  };
+
+  inline Snapshot snapshot()
+  {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    Snapshot s = r.retired;
+    for(size_t j=0; j < r.slots.size(); j++)
+      for(int i=0; i < NCOUNTERS; i++)
+        {
+          s.count[i]   += r.slots[j]->count[i].load(std::memory_order_relaxed);
+          s.seconds[i] += 1.e-9 *
+            r.slots[j]->nanos[i].load(std::memory_order_relaxed);
+        }
+    return s;
+  }
+
+  inline void reset()
+  {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    r.retired = Snapshot();
+    for(size_t j=0; j < r.slots.size(); j++)
+      for(int i=0; i < NCOUNTERS; i++)
+        {
+          r.slots[j]->count[i].store(0, std::memory_order_relaxed);
+          r.slots[j]->nanos[i].store(0, std::memory_order_relaxed);
+        }
+  }
+
+  inline void dump(std::ostream& os=std::cout)
+  {
+    Snapshot s = snapshot();
+    char record[80];
+    sprintf(record, "%-16s %16s %12s %12s",
+            "hotpath", "count", "time (s)", "mean (us)");
+    os << record << std::endl;
+    for(int i=0; i < NCOUNTERS; i++)
+      {
+        if ( s.count[i] == 0 ) continue;
+        double mean = s.seconds[i] > 0 ? 1.e6*s.seconds[i]/s.count[i] : 0;
+        sprintf(record, "%-16s %16llu %12.4f %12.3f",
+                name(i), s.count[i], s.seconds[i], mean);
+        os << record << std::endl;
+      }
+  }
+
+  inline void atexitDump() { dump(); }
+
+  // switch instrumentation on or off; dumpAtExit prints a summary
+  // when the program ends
+  inline void enable(bool on=true, bool dumpAtExit=false)
+  {
+    flag().store(on, std::memory_order_relaxed);
+    static bool registered = false;
+    if ( on && dumpAtExit && !registered )
+      {
+        registered = true;
+        atexit(atexitDump);
+      }
+  }
+
+  // honour HOTPATH environment variable at load time
+  struct Init
+  {
+    Init() { if ( getenv("HOTPATH") ) enable(true, true); }
+  };
+  static Init init;
+}
+
+#endif
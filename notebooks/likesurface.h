@@ -0,0 +1,240 @@
+#ifndef LIKESURFACE_H
+#define LIKESURFACE_H
+//-----------------------------------------------------------------------
+// File: likesurface.h
+// Description: Dense grid of the likelihood of study.cc,
+//
+//                L(s, b) = Poisson(D | s + b) GammaDist(b | gamma, mu, beta),
+//
+//              over the box [smin, smax] x [bmin, bmax], with grid
+//              points at the centers of the cells of a TH2 with the same
+//              binning.
+//
+//              In log form,
+//
+//                ln L = D ln(s + b) + R(s) + C(b),
+//
+//              where R(s) = -s and C(b) collects -b, -ln D! and the log
+//              of the gamma density. R and C are computed once per row
+//              and column, so each grid point costs a log and an exp.
+//              The grid is filled in square tiles, small enough that a
+//              tile and its slices of R and C stay in cache, which are
+//              handed out to threads in turn.
+//
+//              While a tile is filled, the maximum of each of its
+//              columns is recorded, so the profile ridge bhat(s) (the
+//              bestf curve of Study) and the global maximum come out of
+//              the same pass. Contour levels are derived from the grid
+//              afterwards, either from the likelihood ratio or from the
+//              probability content of the region above the level.
+//
+// Created: Oct. 2026
+//-----------------------------------------------------------------------
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <thread>
+#include <vector>
+//-----------------------------------------------------------------------
+struct LikelihoodSurface
+{
+  enum { TILE = 64 };          // 64 x 64 doubles = 32 kB per tile
+
+  int    D;
+  double gamma;
+  double mu;
+  double beta;
+  int    nthreads;
+
+  int    ns;                   // number of points in s (x axis)
+  int    nb;                   // number of points in b (y axis)
+  double smin;
+  double smax;
+  double bmin;
+  double bmax;
+
+  std::vector<double> L;       // L[j*ns + i] = L(s_i, b_j)
+  std::vector<double> ridge;   // b of maximum L at each s_i
+  double Lmax;                 // maximum of L over the grid
+  double shat;                 // location of the maximum
+  double bhat;
+  double sum;                  // sum of L over the grid
+
+  LikelihoodSurface(int _D, double _gamma, double _mu, double _beta,
+                    int _nthreads=0)
+    : D(_D),
+      gamma(_gamma),
+      mu(_mu),
+      beta(_beta),
+      nthreads(_nthreads > 0
+               ? _nthreads
+               : std::max(1, (int)std::thread::hardware_concurrency())),
+      ns(0),
+      nb(0),
+      smin(0),
+      smax(0),
+      bmin(0),
+      bmax(0),
+      L(),
+      ridge(),
+      Lmax(0),
+      shat(0),
+      bhat(0),
+      sum(0)
+  {}
+
+  ~LikelihoodSurface() {}
+
+  double s(int i) const { return smin + (i+0.5)*(smax-smin)/ns; }
+  double b(int j) const { return bmin + (j+0.5)*(bmax-bmin)/nb; }
+
+  double operator()(int i, int j) const { return L[j*ns + i]; }
+
+  // fill the grid of _ns x _nb points
+  void fill(int _ns, double _smin, double _smax,
+            int _nb, double _bmin, double _bmax)
+  {
+    ns = _ns;
+    nb = _nb;
+    smin = _smin;
+    smax = _smax;
+    bmin = _bmin;
+    bmax = _bmax;
+    L.resize((size_t)ns*nb);
+    ridge.assign(ns, 0);
+
+    // factors that depend only on s or only on b
+    std::vector<double> R(ns), C(nb), lnS(ns);
+    double c0 = -lgamma(D+1.0) - lgamma(gamma) - gamma*log(beta);
+    for(int i=0; i < ns; i++) R[i] = -s(i);
+    for(int j=0; j < nb; j++)
+      {
+        double x = b(j) - mu;
+        C[j] = x > 0
+          ? -b(j) + c0 + (gamma-1)*log(x) - x/beta
+          : -INFINITY;
+      }
+
+    // column maxima of each row of tiles, merged below
+    int tiles_s = (ns + TILE-1) / TILE;
+    int tiles_b = (nb + TILE-1) / TILE;
+    int ntiles  = tiles_s * tiles_b;
+    std::vector<double> colmax((size_t)tiles_b*ns, -1);
+    std::vector<int>    colarg((size_t)tiles_b*ns, 0);
+    std::vector<double> tilesum(ntiles, 0);
+
+    std::atomic<int> next(0);
+    auto work = [&]()
+      {
+        for(int t = next++; t < ntiles; t = next++)
+          {
+            int ts = t % tiles_s;
+            int tb = t / tiles_s;
+            int i0 = ts*TILE, i1 = std::min(ns, i0 + TILE);
+            int j0 = tb*TILE, j1 = std::min(nb, j0 + TILE);
+            double* cmax = &colmax[(size_t)tb*ns];
+            int*    carg = &colarg[(size_t)tb*ns];
+            double  tsum = 0;
+            for(int j=j0; j < j1; j++)
+              {
+                double  bj  = b(j);
+                double  Cj  = C[j];
+                double* row = &L[(size_t)j*ns];
+                for(int i=i0; i < i1; i++)
+                  {
+                    double n = s(i) + bj;
+                    double y = D > 0
+                      ? (n > 0 ? exp(D*log(n) + R[i] + Cj) : 0)
+                      : exp(R[i] + Cj);
+                    row[i] = y;
+                    tsum  += y;
+                    if ( y > cmax[i] )
+                      {
+                        cmax[i] = y;
+                        carg[i] = j;
+                      }
+                  }
+              }
+            tilesum[t] = tsum;
+          }
+      };
+    int nt = std::min(nthreads, ntiles);
+    if ( nt <= 1 )
+      work();
+    else
+      {
+        std::vector<std::thread> pool;
+        for(int k=0; k < nt; k++) pool.push_back(std::thread(work));
+        for(int k=0; k < nt; k++) pool[k].join();
+      }
+
+    // merge column maxima into the ridge, refined by a parabola through
+    // ln L at the best grid point and its neighbours
+    Lmax = -1;
+    sum  = 0;
+    for(int t=0; t < ntiles; t++) sum += tilesum[t];
+    for(int i=0; i < ns; i++)
+      {
+        double y = -1;
+        int    j = 0;
+        for(int tb=0; tb < tiles_b; tb++)
+          if ( colmax[(size_t)tb*ns + i] > y )
+            {
+              y = colmax[(size_t)tb*ns + i];
+              j = colarg[(size_t)tb*ns + i];
+            }
+        ridge[i] = b(j) + refine(i, j);
+        if ( y > Lmax )
+          {
+            Lmax = y;
+            shat = s(i);
+            bhat = ridge[i];
+          }
+      }
+  }
+
+  // likelihood level at which -2 ln(L / Lmax) = chisq (e.g., 2.30 for
+  // the 68.3% region of a 2-parameter Gaussian likelihood)
+  double ratioLevel(double chisq) const { return Lmax * exp(-0.5*chisq); }
+
+  // likelihood levels such that the grid points with L above level k
+  // hold a fraction content[k] of the sum of L over the grid
+  void contentLevels(int n, double* content, double* level) const
+  {
+    std::vector<double> y(L);
+    std::sort(y.begin(), y.end(), std::greater<double>());
+    std::vector<int> order(n);
+    for(int k=0; k < n; k++) order[k] = k;
+    std::sort(order.begin(), order.end(),
+              [&](int a, int c) { return content[a] < content[c]; });
+    double cum = 0;
+    size_t m = 0;
+    for(int k=0; k < n; k++)
+      {
+        double target = content[order[k]] * sum;
+        while ( m < y.size() && cum < target ) cum += y[m++];
+        level[order[k]] = m > 0 ? y[m-1] : y[0];
+      }
+  }
+
+private:
+  // offset, in b, of the vertex of the parabola through ln L at
+  // rows j-1, j, j+1 of column i
+  double refine(int i, int j) const
+  {
+    if ( j < 1 || j > nb-2 ) return 0;
+    double y0 = L[(size_t)(j-1)*ns + i];
+    double y1 = L[(size_t)j*ns + i];
+    double y2 = L[(size_t)(j+1)*ns + i];
+    if ( !(y0 > 0 && y1 > 0 && y2 > 0) ) return 0;
+    y0 = log(y0);
+    y1 = log(y1);
+    y2 = log(y2);
+    double d = y0 - 2*y1 + y2;
+    if ( !(d < 0) ) return 0;
+    return 0.5*(y0 - y2)/d * (bmax-bmin)/nb;
+  }
+};
+
+#endif
@@ -0,0 +1,461 @@
+#ifndef NESTED_H
+#define NESTED_H
+//-----------------------------------------------------------------------
+// File: nested.h
+// Description: Nested sampling (Skilling, 2004) of the posterior density
+//              of a CosmicCode model, which yields the Bayesian evidence
+//              and, as a by-product, weighted posterior samples.
+//
+//              The prior is uniform in the box given by Model::limits
+//              (optionally narrowed with setBox) and zero wherever
+//              Model::valid is false or the model is unphysical. With
+//              marginalizeH0, H0 is integrated out analytically using
+//              CosmicCode::logLikelihoodH0 (prior flat in log H0) and
+//              only the remaining parameters are sampled.
+//
+//              At each iteration the nbatch live points with the lowest
+//              likelihood are replaced. New points are drawn uniformly
+//              from an enlarged ellipsoid that bounds the surviving live
+//              points, subject to the likelihood constraint, and the
+//              replacements of a batch are shared among threads, which
+//              are started once per run. Each replacement uses its own
+//              random number stream, seeded by (seed, iteration, slot).
+//              Results therefore depend on nbatch, which sets the
+//              shrinkage schedule, but not on the number of threads. By
+//              default nbatch equals the number of threads; give it
+//              explicitly for results that are the same on any machine.
+//
+// Created: Oct. 2026
+//-----------------------------------------------------------------------
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "cosmiccode.cc"
+//-----------------------------------------------------------------------
+struct NestedSampler
+{
+  enum { MAXDIM = DistanceTable::MAXDIM+1 };
+
+  CosmicCode& code;
+  std::vector<SupernovaData> data;   // one copy per thread
+  int    nlive;
+  int    nthreads;
+  int    nbatch;                     // live points replaced per iteration
+  unsigned long seed;
+  bool   marginal;                   // integrate H0 analytically
+  int    ndim;
+  double lo[MAXDIM];
+  double hi[MAXDIM];
+  double enlarge;                    // ellipsoid enlargement (in d^2)
+  int    maxtries;                   // per replacement
+
+  // results
+  double logZ;                       // log evidence
+  double dlogZ;                      // its uncertainty
+  double information;                // H = KL(posterior | prior) (nats)
+  int    niter;
+  long   ncall;                      // likelihood evaluations
+  std::vector<double> samples;       // dead points, then final live ones
+  std::vector<double> logl;
+  std::vector<double> logwt;         // log(L * dX)
+
+  NestedSampler(CosmicCode& _code, SupernovaData& _data,
+                int _nlive=400, int _nthreads=0, int _nbatch=0,
+                unsigned long _seed=42)
+    : code(_code),
+      data(),
+      nlive(_nlive),
+      nthreads(_nthreads > 0
+               ? _nthreads
+               : std::max(1, (int)std::thread::hardware_concurrency())),
+      nbatch(1),
+      seed(_seed),
+      marginal(false),
+      ndim(0),
+      enlarge(1.5),
+      maxtries(1000000),
+      logZ(0),
+      dlogZ(0),
+      information(0),
+      niter(0),
+      ncall(0)
+  {
+    data.assign(nthreads, _data);
+    setBatch(_nbatch > 0 ? _nbatch : nthreads);
+    marginalizeH0(false);
+  }
+
+  ~NestedSampler() {}
+
+  // sample H0 (false) or integrate it out analytically (true).
+  // Resets the prior box to the limits of the model.
+  void marginalizeH0(bool yes=true)
+  {
+    marginal = yes;
+    double l[MAXDIM], h[MAXDIM];
+    code.model.limits(l, h);
+    ndim = 0;
+    for(int i=0; i < code.model.size(); i++)
+      {
+        if ( marginal && i == code.model.h0index() ) continue;
+        lo[ndim] = l[i];
+        hi[ndim] = h[i];
+        ndim++;
+      }
+  }
+
+  // narrow the prior box
+  void setBox(double* _lo, double* _hi)
+  {
+    for(int i=0; i < ndim; i++)
+      {
+        lo[i] = _lo[i];
+        hi[i] = _hi[i];
+      }
+  }
+
+  // number of live points replaced per iteration (at most nlive/2).
+  // Only a batch of more than one point can be shared among threads,
+  // but the batch size also sets the shrinkage schedule, so results
+  // depend on it.
+  void setBatch(int n) { nbatch = std::max(1, std::min(n, nlive/2)); }
+
+  double logLikelihood(double* theta, SupernovaData& d)
+  {
+    double p[MAXDIM];
+    double y;
+    if ( marginal )
+      {
+        double H0 = 0.5*(code.H0min() + code.H0max());
+        code.expand(theta, H0, p);
+        if ( !code.model.valid(p) ) return -INFINITY;
+        y = code.logLikelihoodH0(theta, d, CosmicCode::MARGINAL);
+      }
+    else
+      {
+        for(int i=0; i < ndim; i++) p[i] = theta[i];
+        if ( !code.model.valid(p) ) return -INFINITY;
+        y = code.logLikelihood(p, d);
+      }
+    return std::isnan(y) ? -INFINITY : y;
+  }
+
+  // Run until the evidence in the live points would change log Z by
+  // less than tolerance. Return false if a replacement cannot be found.
+  bool run(double tolerance=0.01, int maxiter=1000000)
+  {
+    samples.clear();
+    logl.clear();
+    logwt.clear();
+    ncall = 0;
+    niter = 0;
+    logZ  = -INFINITY;
+    information = 0;
+
+    std::vector<double> theta(nlive*ndim);
+    std::vector<double> L(nlive);
+
+    // initial live points from the prior
+    {
+      std::mt19937_64 rng(stream(0, 0));
+      std::uniform_real_distribution<double> U(0, 1);
+      for(int i=0; i < nlive; i++)
+        {
+          double* t = &theta[i*ndim];
+          for(int k=0; k < ndim; k++) t[k] = lo[k] + (hi[k]-lo[k])*U(rng);
+          L[i] = logLikelihood(t, data[0]);
+        }
+      ncall += nlive;
+    }
+
+    double logX = 0;   // log of prior volume enclosed by live points
+    int k = std::max(1, std::min(nbatch, nlive/2));
+    std::vector<int> order(nlive);
+    std::vector<double> cand(k*ndim);
+    std::vector<double> candL(k);
+    std::vector<long> calls(k);
+    bool ok = true;
+
+    // Threads 1..nt-1 live for the whole run. For each batch, the main
+    // thread posts the ellipsoid and threshold, bumps round, and takes
+    // slots 0, nt, 2nt, ... itself; thread t takes slots t, t+nt, ...
+    int nt = std::min(nthreads, k);
+    Ellipsoid E;
+    double Lstar = 0;
+    std::mutex mtx;
+    std::condition_variable wake, finished;
+    int  round   = 0;
+    int  pending = 0;
+    bool stop    = false;
+    auto work = [&](int t)
+      {
+        for(int seen=0; ; seen++)
+          {
+            {
+              std::unique_lock<std::mutex> lock(mtx);
+              wake.wait(lock, [&]() { return stop || round > seen; });
+              if ( stop ) return;
+            }
+            replace(E, Lstar, t, nt, k, cand, candL, calls, data[t]);
+            std::lock_guard<std::mutex> lock(mtx);
+            if ( --pending == 0 ) finished.notify_one();
+          }
+      };
+    std::vector<std::thread> pool;
+    for(int t=1; t < nt; t++) pool.push_back(std::thread(work, t));
+
+    for(niter=0; niter < maxiter; niter++)
+      {
+        // stop when the live points can no longer change log Z much
+        double Lmax = *std::max_element(L.begin(), L.end());
+        if ( logZ > -INFINITY && Lmax + logX < logZ + log(tolerance) ) break;
+
+        for(int i=0; i < nlive; i++) order[i] = i;
+        std::partial_sort(order.begin(), order.begin()+k, order.end(),
+                          [&](int a, int b) { return L[a] < L[b]; });
+
+        // remove the k worst points: the j-th shrinks the volume by
+        // the largest of nlive-j uniform variates
+        for(int j=0; j < k; j++)
+          {
+            int i = order[j];
+            double logXnew = logX - 1.0/(nlive - j);
+            double w = L[i] + logX + log1p(-exp(logXnew - logX));
+            accumulate(&theta[i*ndim], L[i], w);
+            logX = logXnew;
+          }
+        // bounding ellipsoid of the survivors
+        {
+          std::lock_guard<std::mutex> lock(mtx);
+          Lstar = L[order[k-1]];
+          bounding(theta, order, k, E);
+          pending = nt-1;
+          round++;
+        }
+        wake.notify_all();
+
+        // find replacements in parallel
+        replace(E, Lstar, 0, nt, k, cand, candL, calls, data[0]);
+        {
+          std::unique_lock<std::mutex> lock(mtx);
+          finished.wait(lock, [&]() { return pending == 0; });
+        }
+        for(int j=0; j < k; j++)
+          {
+            ncall += calls[j];
+            if ( !(candL[j] > Lstar) ) ok = false;
+            int i = order[j];
+            for(int c=0; c < ndim; c++) theta[i*ndim+c] = cand[j*ndim+c];
+            L[i] = candL[j];
+          }
+        if ( !ok )
+          {
+            std::cout << "** NestedSampler ** unable to find a point with"
+                      << " log L > " << Lstar << std::endl;
+            break;
+          }
+      }
+
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      stop = true;
+    }
+    wake.notify_all();
+    for(size_t t=0; t < pool.size(); t++) pool[t].join();
+
+    // add the live points, which share the remaining volume
+    for(int i=0; i < nlive; i++)
+      accumulate(&theta[i*ndim], L[i], L[i] + logX - log((double)nlive));
+
+    dlogZ = sqrt(std::max(information, 0.0) / nlive);
+
+    char record[120];
+    sprintf(record, "NestedSampler: log Z = %10.3f +/- %-6.3f "
+            "(%d iterations, %ld calls)", logZ, dlogZ, niter, ncall);
+    std::cout << record << std::endl;
+    return ok;
+  }
+
+  // posterior samples, resampled with equal weights
+  int posterior(double* out, int n, unsigned long s=1)
+  {
+    int m = logl.size();
+    if ( m == 0 ) return 0;
+    std::vector<double> wt(m);
+    for(int i=0; i < m; i++) wt[i] = exp(logwt[i] - logZ);
+    std::discrete_distribution<int> pick(wt.begin(), wt.end());
+    std::mt19937_64 rng(s);
+    for(int i=0; i < n; i++)
+      {
+        int j = pick(rng);
+        for(int c=0; c < ndim; c++) out[i*ndim+c] = samples[j*ndim+c];
+      }
+    return n;
+  }
+
+  int size() const { return logl.size(); }
+
+private:
+  struct Ellipsoid
+  {
+    bool   box;                      // sample the prior box instead
+    double mean[MAXDIM];
+    double L[MAXDIM][MAXDIM];        // Cholesky factor, scaled
+  };
+
+  // seed for a given iteration and replacement slot
+  unsigned long stream(int iter, int slot) const
+  {
+    unsigned long x = seed +
+      0x9E3779B97F4A7C15UL * ((unsigned long)iter*nbatch + slot + 1);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9UL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBUL;
+    return x ^ (x >> 31);
+  }
+
+  void accumulate(double* t, double lnL, double w)
+  {
+    for(int c=0; c < ndim; c++) samples.push_back(t[c]);
+    logl.push_back(lnL);
+    logwt.push_back(w);
+    if ( !(w > -INFINITY) ) return;
+
+    // update evidence and information (Skilling, 2006)
+    double Znew = logZ > -INFINITY
+      ? std::max(logZ, w) + log1p(exp(-fabs(logZ - w)))
+      : w;
+    double H = exp(w - Znew) * lnL - Znew;
+    if ( logZ > -INFINITY ) H += exp(logZ - Znew) * (information + logZ);
+    information = H;
+    logZ = Znew;
+  }
+
+  // ellipsoid that bounds the survivors order[k...], enlarged
+  void bounding(std::vector<double>& theta, std::vector<int>& order, int k,
+                Ellipsoid& E)
+  {
+    int n = nlive - k;
+    double C[MAXDIM][MAXDIM];
+    for(int a=0; a < ndim; a++)
+      {
+        E.mean[a] = 0;
+        for(int j=k; j < nlive; j++) E.mean[a] += theta[order[j]*ndim+a];
+        E.mean[a] /= n;
+      }
+    for(int a=0; a < ndim; a++)
+      for(int b=0; b <= a; b++)
+        {
+          double s = 0;
+          for(int j=k; j < nlive; j++)
+            {
+              double* t = &theta[order[j]*ndim];
+              s += (t[a] - E.mean[a]) * (t[b] - E.mean[b]);
+            }
+          C[a][b] = C[b][a] = s / n;
+        }
+
+    // Cholesky decomposition C = L L^T
+    E.box = false;
+    double logdet = 0;
+    for(int a=0; a < ndim && !E.box; a++)
+      for(int b=0; b <= a; b++)
+        {
+          double s = C[a][b];
+          for(int c=0; c < b; c++) s -= E.L[a][c] * E.L[b][c];
+          if ( a == b )
+            {
+              if ( !(s > 0) ) { E.box = true; break; }
+              E.L[a][a] = sqrt(s);
+              logdet += log(s);
+            }
+          else
+            E.L[a][b] = s / E.L[b][b];
+        }
+    if ( E.box ) return;
+    for(int a=0; a < ndim; a++)
+      for(int b=a+1; b < ndim; b++) E.L[a][b] = 0;
+
+    // largest Mahalanobis distance of the survivors
+    double d2max = 0;
+    for(int j=k; j < nlive; j++)
+      {
+        double y[MAXDIM];
+        double* t = &theta[order[j]*ndim];
+        double d2 = 0;
+        for(int a=0; a < ndim; a++)
+          {
+            double s = t[a] - E.mean[a];
+            for(int c=0; c < a; c++) s -= E.L[a][c] * y[c];
+            y[a] = s / E.L[a][a];
+            d2 += y[a]*y[a];
+          }
+        if ( d2 > d2max ) d2max = d2;
+      }
+    double scale = sqrt(enlarge * d2max);
+    for(int a=0; a < ndim; a++)
+      for(int b=0; b <= a; b++) E.L[a][b] *= scale;
+
+    // use the box if it is smaller than the ellipsoid
+    double logV = 0.5*ndim*log(M_PI) - lgamma(0.5*ndim + 1)
+      + 0.5*logdet + ndim*log(scale);
+    double logbox = 0;
+    for(int a=0; a < ndim; a++) logbox += log(hi[a] - lo[a]);
+    E.box = logV >= logbox;
+  }
+
+  // find replacements for slots first, first+step, ... < k
+  void replace(const Ellipsoid& E, double Lstar, int first, int step, int k,
+               std::vector<double>& cand, std::vector<double>& candL,
+               std::vector<long>& calls, SupernovaData& d)
+  {
+    for(int j=first; j < k; j += step)
+      {
+        std::mt19937_64 rng(stream(niter+1, j));
+        std::uniform_real_distribution<double> U(0, 1);
+        std::normal_distribution<double> G(0, 1);
+        double* t = &cand[j*ndim];
+        candL[j] = -INFINITY;
+        calls[j] = 0;
+        for(int tries=0; tries < maxtries; tries++)
+          {
+            bool inside = true;
+            if ( E.box )
+              for(int a=0; a < ndim; a++)
+                t[a] = lo[a] + (hi[a]-lo[a])*U(rng);
+            else
+              {
+                // uniform in unit ball, then map to ellipsoid
+                double u[MAXDIM];
+                double r2 = 0;
+                for(int a=0; a < ndim; a++)
+                  {
+                    u[a] = G(rng);
+                    r2 += u[a]*u[a];
+                  }
+                double r = pow(U(rng), 1.0/ndim) / sqrt(r2);
+                for(int a=0; a < ndim; a++)
+                  {
+                    t[a] = E.mean[a];
+                    for(int c=0; c <= a; c++) t[a] += E.L[a][c] * u[c] * r;
+                    inside = inside && t[a] >= lo[a] && t[a] <= hi[a];
+                  }
+              }
+            if ( !inside ) continue;
+            calls[j]++;
+            double y = logLikelihood(t, d);
+            if ( y > Lstar )
+              {
+                candL[j] = y;
+                break;
+              }
+          }
+      }
+  }
+};
+
+#endif
@@ -0,0 +1,413 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+//-----------------------------------------------------------------------
+// File: resample.h
+// Description: Jackknife and bootstrap estimates of the covariance of
+//              the least-squares parameters of a CosmicCode model.
+//
+//              A replica of the sample is given by the multiplicity m_c
+//              of each supernova: for the jackknife all m_c are 1 except
+//              one that is 0, for the bootstrap the m_c are multinomial.
+//              Its chi^2 is
+//
+//                chi^2(p) = sum_c m_c w_c r_c(p)^2,   w_c = 1/dx_c^2,
+//
+//              with r_c = x_c - mu(z_c, p). At the best fit p0 of the
+//              full sample, the residuals r_c, the per-object terms
+//              e_c = w_c r_c^2 and the gradients J_c = dmu/dp(z_c) are
+//              computed once and cached, together with
+//
+//                A = sum_c w_c J_c J_c^T,   g = sum_c w_c J_c r_c.
+//
+//              A replica's chi^2 at p0 is then the cached total plus the
+//              corrections (m_c - 1) e_c, and its Gauss-Newton step from
+//              p0 needs only the corrections (m_c - 1) w_c J_c J_c^T and
+//              (m_c - 1) w_c J_c r_c to A and g, which for the jackknife
+//              is a rank-one update. No model evaluations are needed.
+//              Optionally, each replica can be refined by further
+//              Gauss-Newton steps, each a fresh pass over the data.
+//
+//              The fit, the residuals and the gradients (central
+//              differences) all use the quadrature, with the table of
+//              the CosmicCode (if any) switched off, as in fisher.h: the
+//              patches of the table are continuous only to within its
+//              estimated error, which a difference over a patch edge
+//              would amplify by 1/step.
+//
+//              Replicas are shared among threads. Bootstrap replica b
+//              draws its multiplicities from its own random number
+//              stream, seeded by (seed, b), so results do not depend on
+//              the number of threads.
+//
+// Created: Oct. 2026
+//-----------------------------------------------------------------------
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "cosmiccode.cc"
+//-----------------------------------------------------------------------
+struct Resampler
+{
+  enum { MAXDIM = DistanceTable::MAXDIM+1 };
+
+  CosmicCode& code;
+  std::vector<double> z;
+  std::vector<double> x;
+  std::vector<double> w;         // 1/dx^2
+  int    n;
+  int    ndim;
+  int    nthreads;
+  unsigned long seed;
+  int    steps;                  // refinement steps per replica
+  double step;                   // relative step of the derivatives
+
+  // cache at the best fit of the full sample
+  double p0[MAXDIM];
+  double chisq0;
+  std::vector<double> r;         // residuals
+  std::vector<double> e;         // w r^2
+  std::vector<double> J;         // J[c*ndim + i] = dmu/dp_i at z_c
+  double A[MAXDIM*MAXDIM];
+  double g[MAXDIM];
+
+  // replica estimates, row by row
+  std::vector<double> jackknifeSamples;
+  std::vector<double> bootstrapSamples;
+
+  Resampler(CosmicCode& _code, double* _z, double* _x, double* _dx,
+            int _n, int _nthreads=0, unsigned long _seed=42)
+    : code(_code),
+      z(_z, _z+_n),
+      x(_x, _x+_n),
+      w(_n),
+      n(_n),
+      ndim(_code.model.size()),
+      nthreads(_nthreads > 0
+               ? _nthreads
+               : std::max(1, (int)std::thread::hardware_concurrency())),
+      seed(_seed),
+      steps(0),
+      step(1.e-4),
+      chisq0(0),
+      r(),
+      e(),
+      J(),
+      jackknifeSamples(),
+      bootstrapSamples()
+  {
+    for(int c=0; c < n; c++) w[c] = 1 / (_dx[c]*_dx[c]);
+    for(int i=0; i < MAXDIM; i++) p0[i] = 0;
+  }
+
+  ~Resampler() {}
+
+  // number of Gauss-Newton passes over the data used to refine each
+  // replica after the cached step (0 = none)
+  void setSteps(int k) { steps = std::max(0, k); }
+
+  // fit the full sample, starting at p, and cache the residuals and
+  // gradients at the best fit. Returns false, leaving the cache empty,
+  // if the fit fails.
+  bool fit(double* p, int maxiter=50)
+  {
+    // fit and cache with the table off, so that the residuals match
+    // the gradients and the refinement passes, which use the quadrature
+    bool usetable = code.usetable;
+    if ( usetable ) code.useTable(false);
+    std::vector<double> m(n, 1);
+    for(int i=0; i < ndim; i++) p0[i] = p[i];
+    bool ok = gaussNewton(&m[0], p0, maxiter, 1.e-10);
+    if ( ok )
+      {
+        r.resize(n);
+        e.resize(n);
+        J.resize((size_t)n*ndim);
+        evaluate(p0, &r[0], &J[0]);
+      }
+    if ( usetable ) code.useTable(true);
+
+    chisq0 = 0;
+    if ( !ok )
+      {
+        std::cout << "** Resampler ** fit of full sample failed" << std::endl;
+        r.clear();
+        e.clear();
+        J.clear();
+        return false;
+      }
+    chisq0 = 0;
+    for(int i=0; i < ndim*ndim; i++) A[i] = 0;
+    for(int i=0; i < ndim; i++) g[i] = 0;
+    for(int c=0; c < n; c++)
+      {
+        e[c] = w[c]*r[c]*r[c];
+        chisq0 += e[c];
+        accumulate(&J[c*ndim], w[c], r[c], A, g);
+      }
+    return true;
+  }
+
+  // chi^2 at the best fit for a replica with multiplicities m, from
+  // the cache
+  double chisq(double* m) const
+  {
+    double y = chisq0;
+    for(int c=0; c < n; c++) if ( m[c] != 1 ) y += (m[c]-1)*e[c];
+    return y;
+  }
+
+  // jackknife (leave-one-out) covariance of the parameters (ndim x
+  // ndim, row by row). The replica estimates are kept in
+  // jackknifeSamples. Returns false without a successful fit.
+  bool jackknife(double* cov)
+  {
+    if ( !cached() ) return false;
+    jackknifeSamples.assign((size_t)n*ndim, 0);
+    std::vector<char> ok(n, 1);
+    // the refinement passes run in threads, so switch the table off
+    // here rather than in evaluate
+    bool usetable = code.usetable && steps > 0;
+    if ( usetable ) code.useTable(false);
+    run(n, [&](int k)
+        {
+          double Ak[MAXDIM*MAXDIM], gk[MAXDIM];
+          std::copy(A, A+ndim*ndim, Ak);
+          std::copy(g, g+ndim, gk);
+          accumulate(&J[k*ndim], -w[k], r[k], Ak, gk);
+          double* p = &jackknifeSamples[(size_t)k*ndim];
+          ok[k] = update(Ak, gk, p);
+          if ( ok[k] && steps > 0 )
+            {
+              std::vector<double> m(n, 1);
+              m[k] = 0;
+              ok[k] = gaussNewton(&m[0], p, steps, 0);
+            }
+        });
+    if ( usetable ) code.useTable(true);
+    covariance(jackknifeSamples, n, double(n-1)/n, cov);
+    return std::find(ok.begin(), ok.end(), 0) == ok.end();
+  }
+
+  // bootstrap covariance from nreplica (at least 2) replicas. The
+  // replica estimates are kept in bootstrapSamples. Returns false
+  // without a successful fit.
+  bool bootstrap(int nreplica, double* cov)
+  {
+    if ( nreplica < 2 )
+      {
+        std::cout << "** Resampler ** at least 2 replicas are needed"
+                  << std::endl;
+        return false;
+      }
+    if ( !cached() ) return false;
+    bootstrapSamples.assign((size_t)nreplica*ndim, 0);
+    std::vector<char> ok(nreplica, 1);
+    bool usetable = code.usetable && steps > 0;
+    if ( usetable ) code.useTable(false);
+    run(nreplica, [&](int b)
+        {
+          std::vector<double> m(n, 0);
+          std::mt19937_64 rng(stream(b));
+          const double scale = n / 9007199254740992.0;   // n 2^-53
+          for(int c=0; c < n; c++) m[(int)((rng() >> 11) * scale)]++;
+
+          double Ab[MAXDIM*MAXDIM], gb[MAXDIM];
+          std::copy(A, A+ndim*ndim, Ab);
+          std::copy(g, g+ndim, gb);
+          for(int c=0; c < n; c++)
+            if ( m[c] != 1 )
+              accumulate(&J[c*ndim], (m[c]-1)*w[c], r[c], Ab, gb);
+          double* p = &bootstrapSamples[(size_t)b*ndim];
+          ok[b] = update(Ab, gb, p);
+          if ( ok[b] && steps > 0 ) ok[b] = gaussNewton(&m[0], p, steps, 0);
+        });
+    if ( usetable ) code.useTable(true);
+    covariance(bootstrapSamples, nreplica, 1.0/(nreplica-1), cov);
+    return std::find(ok.begin(), ok.end(), 0) == ok.end();
+  }
+
+private:
+  // true if fit has filled the cache
+  bool cached() const
+  {
+    if ( (int)r.size() == n && n > 0 ) return true;
+    std::cout << "** Resampler ** no fit of the full sample" << std::endl;
+    return false;
+  }
+
+  // seed of bootstrap replica b
+  unsigned long stream(int b) const
+  {
+    unsigned long y = seed + 0x9E3779B97F4A7C15UL * (b + 1);
+    y = (y ^ (y >> 30)) * 0xBF58476D1CE4E5B9UL;
+    y = (y ^ (y >> 27)) * 0x94D049BB133111EBUL;
+    return y ^ (y >> 31);
+  }
+
+  // add weight * (j j^T, j r) to (A, g)
+  void accumulate(const double* j, double weight, double res,
+                  double* Ai, double* gi) const
+  {
+    for(int a=0; a < ndim; a++)
+      {
+        gi[a] += weight * j[a] * res;
+        for(int b=0; b < ndim; b++) Ai[a*ndim+b] += weight * j[a] * j[b];
+      }
+  }
+
+  // p = p0 + A^-1 g
+  bool update(double* Ai, double* gi, double* p) const
+  {
+    double d[MAXDIM];
+    if ( !solve(Ai, gi, d) ) return false;
+    for(int a=0; a < ndim; a++) p[a] = p0[a] + d[a];
+    return true;
+  }
+
+  // residuals and gradients of mu at p for all objects
+  void evaluate(double* p, double* res, double* jac)
+  {
+    int h = code.model.h0index();
+    double cz[DistanceTable::MAXORDER];
+    bool fast = code.prepare(p, cz);
+    double H = code.offset - 5*log10(p[h]);
+    double q[MAXDIM];
+    for(int c=0; c < n; c++)
+      res[c] = x[c] - code.modulus(z[c], p, fast, cz, H);
+    if ( !jac ) return;
+
+    // differentiate the quadrature, not the table. Within fit,
+    // jackknife and bootstrap the table is already off, and is not
+    // touched here.
+    bool usetable = code.usetable;
+    if ( usetable ) code.useTable(false);
+    for(int a=0; a < ndim; a++)
+      {
+        if ( a == h )
+          {
+            double d = -5 / (log(10.0) * p[h]);
+            for(int c=0; c < n; c++) jac[c*ndim+a] = d;
+            continue;
+          }
+        for(int b=0; b < ndim; b++) q[b] = p[b];
+        double eps = step * std::max(fabs(p[a]), 0.01);
+        q[a] = p[a] + eps;
+        bool fup = code.prepare(q, cz);
+        for(int c=0; c < n; c++)
+          jac[c*ndim+a] = code.modulus(z[c], q, fup, cz, H);
+        q[a] = p[a] - eps;
+        bool fdn = code.prepare(q, cz);
+        for(int c=0; c < n; c++)
+          jac[c*ndim+a] = (jac[c*ndim+a] -
+                           code.modulus(z[c], q, fdn, cz, H)) / (2*eps);
+      }
+    if ( usetable ) code.useTable(true);
+  }
+
+  // Gauss-Newton minimization of the chi^2 with multiplicities m,
+  // starting at p. Stops after maxiter steps or when the change in
+  // chi^2 is below tolerance.
+  bool gaussNewton(double* m, double* p, int maxiter, double tolerance)
+  {
+    std::vector<double> res(n), jac((size_t)n*ndim);
+    double last = INFINITY;
+    for(int iter=0; iter < maxiter; iter++)
+      {
+        evaluate(p, &res[0], &jac[0]);
+        double Ai[MAXDIM*MAXDIM], gi[MAXDIM], d[MAXDIM];
+        for(int a=0; a < ndim*ndim; a++) Ai[a] = 0;
+        for(int a=0; a < ndim; a++) gi[a] = 0;
+        double y = 0;
+        for(int c=0; c < n; c++)
+          {
+            if ( m[c] == 0 ) continue;
+            y += m[c]*w[c]*res[c]*res[c];
+            accumulate(&jac[c*ndim], m[c]*w[c], res[c], Ai, gi);
+          }
+        if ( std::isnan(y) || !solve(Ai, gi, d) ) return false;
+        for(int a=0; a < ndim; a++) p[a] += d[a];
+        if ( fabs(last - y) < tolerance*(1 + y) ) break;
+        last = y;
+      }
+    return true;
+  }
+
+  // solve the symmetric positive definite system A d = b by Cholesky
+  bool solve(const double* Ai, const double* b, double* d) const
+  {
+    double L[MAXDIM*MAXDIM];
+    for(int i=0; i < ndim; i++)
+      for(int j=0; j <= i; j++)
+        {
+          double s = Ai[i*ndim+j];
+          for(int k=0; k < j; k++) s -= L[i*ndim+k]*L[j*ndim+k];
+          if ( i == j )
+            {
+              if ( !(s > 0) ) return false;
+              L[i*ndim+i] = sqrt(s);
+            }
+          else
+            L[i*ndim+j] = s / L[j*ndim+j];
+        }
+    double y[MAXDIM];
+    for(int i=0; i < ndim; i++)
+      {
+        double s = b[i];
+        for(int k=0; k < i; k++) s -= L[i*ndim+k]*y[k];
+        y[i] = s / L[i*ndim+i];
+      }
+    for(int i=ndim-1; i >= 0; i--)
+      {
+        double s = y[i];
+        for(int k=i+1; k < ndim; k++) s -= L[k*ndim+i]*d[k];
+        d[i] = s / L[i*ndim+i];
+      }
+    return true;
+  }
+
+  // scale * sum_k (p_k - mean)(p_k - mean)^T over the m estimates in s
+  void covariance(std::vector<double>& s, int m, double scale,
+                  double* cov) const
+  {
+    double mean[MAXDIM];
+    for(int a=0; a < ndim; a++)
+      {
+        mean[a] = 0;
+        for(int k=0; k < m; k++) mean[a] += s[(size_t)k*ndim+a];
+        mean[a] /= m;
+      }
+    for(int a=0; a < ndim; a++)
+      for(int b=0; b < ndim; b++)
+        {
+          double y = 0;
+          for(int k=0; k < m; k++)
+            y += (s[(size_t)k*ndim+a] - mean[a]) *
+              (s[(size_t)k*ndim+b] - mean[b]);
+          cov[a*ndim+b] = scale * y;
+        }
+  }
+
+  // apply task to replicas 0..m-1, replica k in thread k % nthreads
+  template <class Task>
+  void run(int m, Task task)
+  {
+    int nt = std::min(nthreads, std::max(1, m));
+    auto work = [&](int t)
+      {
+        for(int k=t; k < m; k += nt) task(k);
+      };
+    if ( nt == 1 )
+      work(0);
+    else
+      {
+        std::vector<std::thread> pool;
+        for(int t=0; t < nt; t++) pool.push_back(std::thread(work, t));
+        for(int t=0; t < nt; t++) pool[t].join();
+      }
+  }
+};
+
+#endif
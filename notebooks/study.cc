@@ -35,6 +35,8 @@
 #include "TF1.h"
 #include "TF2.h"
 #include "util.h"
+#include "hotpath.h"
+#include "likesurface.h"
 
 using namespace std;
 //--------------------------------------------------------------------------
@@ -66,6 +68,7 @@ struct Study
   double XMIN;
   double XMAX;
   double NORM;
+  vector<double> W;          // weights of posterior mixture
  
   ROOT::Math::WrappedMemFunction<Study, double (Study::*)(double)> wfm;
   ROOT::Math::IntegratorOneDim ifn;
@@ -102,7 +105,7 @@ struct Study
           SIZE,
           RULE),
 
-      wfp(*this, &Study::marginalExact),
+      wfp(*this, &Study::fp),
       ifp(wfp, 
           ROOT::Math::IntegrationOneDim::kADAPTIVE,
           ABSTOL,
@@ -110,7 +113,20 @@ struct Study
           SIZE,
           RULE)
     {
+      // weights of the Poisson terms of marginalExact, normalized so
+      // that the posterior for a flat prior is sum_r W[r] Gamma(s|D-r+1)
+      W.resize(D+1);
+      W[0] = pow(K/(1+K), Q+1);
+      double sum = W[0];
+      for(int r=1; r <= D; ++r)
+        {
+          W[r] = W[r-1] * (Q+r) / (r*(1+K));
+          sum += W[r];
+        }
+      for(int r=0; r <= D; ++r) W[r] /= sum;
+
       NORM = 1;
+      hotpath::Timer t(hotpath::INTEGRAL);
       NORM = ifp.Integral(XMIN, XMAX);
     }
   
@@ -121,6 +137,7 @@ struct Study
   //----------------------------------------------------------------------
   double likelihood(double s, double b)
   {
+    hotpath::count(hotpath::LIKELIHOOD);
     return TMath::Poisson(D, s + b) * TMath::GammaDist(b, gamma, mu, beta);
   }
   
@@ -148,6 +165,7 @@ struct Study
   double marginal(double s)
   {
     S = s;
+    hotpath::Timer t(hotpath::INTEGRAL);
     return ifn.Integral(XMIN, XMAX);
   }
   
@@ -169,7 +187,7 @@ struct Study
     double lo = 0;
     double hi = D - B;
     rootfinder.SetFunction(fn, lo, hi);
-    int status = rootfinder.Solve();
+    int status = solve(rootfinder);
     if ( status != 1 )
       {
         cout << "*** Post *** RootFinder failed"
@@ -181,7 +199,7 @@ struct Study
     lo = D - B;
     hi = XMAX;
     rootfinder.SetFunction(fn, lo, hi);
-    status = rootfinder.Solve();
+    status = solve(rootfinder);
     if ( status != 1 )
       {
         cout << "*** Post *** RootFinder failed"
@@ -192,44 +210,13 @@ struct Study
     return true;
   }
   
+  // central Bayesian interval, from the exact posterior quantiles
   bool blimits(double& xmin, double& xmax)
   {
-    double oldCL = CL;
     double alpha = (1-CL)/2;
-    CL = alpha;
-
-    // function whose root is to be found
-    ROOT::Math::WrappedMemFunction<Study,
-      double (Study::*)(double)> fn(*this, &Study::fcdf);
-    ROOT::Math::RootFinder rootfinder;
-    
-    double lo = 0;
-    double hi = D - B;
-    rootfinder.SetFunction(fn, lo, hi);
-    int status = rootfinder.Solve();
-    if ( status != 1 )
-      {
-        cout << "*** Post *** RootFinder failed"
-             << endl;
-        return false;
-      }
-    xmin = rootfinder.Root();
-
-    CL = oldCL + alpha;
-    lo = D - B;
-    hi = XMAX;
-    rootfinder.SetFunction(fn, lo, hi);
-    status = rootfinder.Solve();
-    if ( status != 1 )
-      {
-        cout << "*** Post *** RootFinder failed"
-             << endl;
-        return false;
-      }
-    xmax = rootfinder.Root();
-
-    CL = oldCL;
-    return true;
+    xmin = quantile(alpha);
+    xmax = quantile(1-alpha);
+    return xmin >= 0 && xmax >= 0;
   }
   
   double chisq(double s)
@@ -247,20 +234,37 @@ struct Study
 
   double fm(double b)
   {
+    hotpath::count(hotpath::INTEGRAND);
     double y = likelihood(S, b); 
     return y;
   }
   
-  double fcdf(double x)
-  {
-    return cdf(x) - CL;
-  }
-  
   double lln(double x)
   {
     return -(1+K) + D/(S + x) + Q/x;
   }
-  double cdf(double x) { return ifp.Integral(XMIN, x) / NORM; } 
+  double cdf(double x) 
+  { 
+    hotpath::Timer t(hotpath::INTEGRAL);
+    return ifp.Integral(XMIN, x) / NORM; 
+  } 
+
+  // integrand of ifp
+  double fp(double s)
+  {
+    hotpath::count(hotpath::INTEGRAND);
+    return marginalExact(s);
+  }
+
+  // find root, recording iterations and failures
+  int solve(ROOT::Math::RootFinder& rootfinder)
+  {
+    hotpath::Timer t(hotpath::ROOTSOLVE);
+    int status = rootfinder.Solve();
+    hotpath::count(hotpath::ROOTITERATION, rootfinder.Iterations());
+    if ( status != 1 ) hotpath::count(hotpath::ROOTFAILURE);
+    return status;
+  }
   
   //----------------------------------------------------------------------
   // Compute numerically, best fit of b for a given s
@@ -274,7 +278,7 @@ struct Study
     ROOT::Math::RootFinder rootfinder;
     
     rootfinder.SetFunction(fn, XMIN, XMAX);
-    int status = rootfinder.Solve();
+    int status = solve(rootfinder);
     if ( status != 1 )
       {
         cout << "*** Post *** RootFinder failed"
@@ -293,6 +297,122 @@ struct Study
       double y = 0.5*(q + sqrt(q*q + 4*(1+K)*s*Q))/(1+K);
       return y;
   }
+
+  //----------------------------------------------------------------------
+  // Exact posterior density of s for a flat prior. The marginal 
+  // likelihood is a negative binomial mixture of Poisson terms, so the
+  // posterior is a mixture of gamma densities,
+  //
+  //   p(s|D) = sum_r W[r] s^(D-r) exp(-s) / (D-r)!,
+  //
+  // and its CDF a mixture of regularized incomplete gamma functions 
+  // P(D-r+1, x). Only P(D+1, x) is computed with TMath::Gamma; the 
+  // others follow from P(n, x) = P(n+1, x) + x^n exp(-x) / n!, whose 
+  // terms are all positive.
+  //----------------------------------------------------------------------
+  double density(double s)
+  {
+    if ( s < 0 ) return 0;
+    if ( s == 0 ) return W[D];
+    double t = TMath::Poisson(0, s);   // x^n exp(-x) / n!, n = 0
+    double y = W[D] * t;
+    for(int n=1; n <= D; ++n)
+      {
+        t *= s / n;
+        y += W[D-n] * t;
+      }
+    return y;
+  }
+
+  double cdfExact(double x)
+  {
+    if ( x <= 0 ) return 0;
+    double P = TMath::Gamma(D+1, x);   // P(n+1, x), n = D
+    double t = TMath::Poisson(D, x);   // x^n exp(-x) / n!
+    double y = W[0] * P;
+    for(int r=1; r <= D; ++r)
+      {
+        int n = D-r+1;
+        P += t;                        // P(n, x)
+        y += W[r] * P;
+        t *= n / x;
+      }
+    return y;
+  }
+
+  // value of s below which the posterior probability is p, by Newton's
+  // method safeguarded by bisection. Returns -1 on failure.
+  double quantile(double p)
+  {
+    if ( p <= 0 ) return 0;
+    if ( p >= 1 ) return -1;
+    double lo = 0;
+    double hi = D + 1;
+    while ( cdfExact(hi) < p ) 
+      {
+        lo = hi;
+        hi *= 2;
+        if ( hi > 1.e6 ) return -1;
+      }
+    double x = 0.5*(lo + hi);
+    for(int i=0; i < 100; ++i)
+      {
+        double f = cdfExact(x) - p;
+        if ( f < 0 ) lo = x; else hi = x;
+        double d = density(x);
+        double y = d > 0 ? x - f/d : 0.5*(lo + hi);
+        if ( !(y > lo && y < hi) ) y = 0.5*(lo + hi);
+        if ( fabs(y - x) < 1.e-12*(1 + x) ) return y;
+        x = y;
+      }
+    return x;
+  }
+
+  // upper limit on s at credibility cl
+  double upperLimit(double cl)
+  {
+    return quantile(cl);
+  }
+
+  // shortest interval with posterior probability cl (the posterior is
+  // unimodal). The lower edge is found by regula falsi (Illinois) on 
+  // the difference of the densities at the two edges.
+  bool hpd(double& xmin, double& xmax, double cl)
+  {
+    xmin = 0;
+    xmax = quantile(cl);
+    if ( xmax < 0 ) return false;
+    if ( density(0) >= density(xmax) ) return true;
+
+    double a  = 0;
+    double fa = density(xmax) - density(0);
+    double b  = quantile(1-cl);
+    double fb = -density(b);
+    int side  = 0;
+    for(int i=0; i < 100; ++i)
+      {
+        double c  = (a*fb - b*fa) / (fb - fa);
+        double hi = quantile(cdfExact(c) + cl);
+        if ( hi < 0 ) return false;
+        double fc = density(hi) - density(c);
+        xmin = c;
+        xmax = hi;
+        if ( fabs(fc) <= 1.e-12*density(c) || fabs(b - a) < 1.e-12 ) break;
+        if ( fc*fb > 0 )
+          {
+            b = c; fb = fc;
+            if ( side == -1 ) fa /= 2;
+            side = -1;
+          }
+        else
+          {
+            a = c; fa = fc;
+            if ( side == +1 ) fb /= 2;
+            side = +1;
+          }
+      }
+    return true;
+  }
 };
 
 //----------------------------------------------------------------------------
@@ -308,11 +428,6 @@ double marginal(double* x, double* p)
 {
   return PTR->marginalExact(x[0]);
 }
-
-double likelihood(double* x, double* p)
-{
-  return PTR->likelihood(x[0], x[1]);
-}
 //----------------------------------------------------------------------------
 // MAIN PROGRAM
 //----------------------------------------------------------------------------
@@ -342,10 +457,6 @@ int main(int argc, char** argv)
   double ymin=0;
   double ymax=10;
 
-
-  double x[200];
-  double y[200];
-
   int xbins=80;
   double xstep=(xmax-xmin)/xbins;
   ofstream fout("post.txt");
@@ -369,8 +480,6 @@ int main(int argc, char** argv)
       double b2 = study.bestf(s);
       sprintf(record, "%10.2f %10.3f %10.3f", s, b1, b2);
       bout << record << endl;
-      x[i] = s;
-      y[i] = b2;
     }
   fout.close();
   bout.close();
@@ -421,6 +530,19 @@ int main(int argc, char** argv)
       cout << record << endl;
     }
 
+  if ( study.hpd(lower, upper, study.CL) )
+    {
+      double width = upper - lower;
+      sprintf(record, "\t%10.2f, %-10.2f - width = %-10.2f", 
+              lower, upper, width);
+      cout << "shortest interval using Bayes" << endl;
+      cout << record << endl;
+    }
+
+  sprintf(record, "\t%10.2f", study.upperLimit(0.95));
+  cout << "95% upper limit using Bayes" << endl;
+  cout << record << endl;
+
   double B10 = study.marginalExact(s) / study.marginalExact(0);
   cout << endl;
   sprintf(record, "B10 = %10.3f, sqrt[2ln(B10)] = %10.3f", B10, 
@@ -471,20 +593,45 @@ int main(int argc, char** argv)
   gStyle->SetTitleYOffset(1.35);    //(1.25);
 
 
-  TGraph graph(xbins, x, y);
+  // likelihood on a fine (s, b) grid, filled in parallel, together
+  // with its ridge bhat(s) and the 68.3%, 95.4% and 99.7% contours
+
+  LikelihoodSurface surface(study.D, study.gamma, study.mu, study.beta);
+  surface.fill(300, 0, 30, 300, 0, 6);
+
+  sprintf(record, "maximum of surface at s = %6.2f, b = %6.3f", 
+          surface.shat, surface.bhat);
+  cout << record << endl << endl;
+
+  TH2F hlike("hlike", "", 
+             surface.ns, surface.smin, surface.smax,
+             surface.nb, surface.bmin, surface.bmax);
+  for(int j=0; j < surface.nb; ++j)
+    for(int i=0; i < surface.ns; ++i)
+      hlike.SetBinContent(i+1, j+1, surface(i, j));
+  hlike.SetMinimum(0);
+  hlike.GetXaxis()->SetTitle("expected signal (s)");
+  hlike.GetXaxis()->CenterTitle();
+  hlike.GetYaxis()->SetTitle("expected background (b)");
+  hlike.GetYaxis()->CenterTitle();
+
+  double content[3] = {0.997, 0.954, 0.683};  // increasing levels
+  double levels[3];
+  surface.contentLevels(3, content, levels);
+  TH2F* hcontour = (TH2F*)hlike.Clone("hcontour");
+  hcontour->SetContour(3, levels);
+  hcontour->SetLineColor(kBlack);
+  hcontour->SetLineWidth(2);
+
+  vector<double> sgrid(surface.ns);
+  for(int i=0; i < surface.ns; ++i) sgrid[i] = surface.s(i);
+  TGraph graph(surface.ns, &sgrid[0], &surface.ridge[0]);
   graph.SetLineWidth(2);
 
   TCanvas clike("fig_likelihood", "likelihood", 520, 10, 500, 500);
-  TF2 flike("likelihood", likelihood, 0, 30, 0, 6);
-  flike.SetLineColor(kRed+1);
-  flike.SetLineWidth(2);
-  flike.SetMinimum(0);
-  flike.GetHistogram()->GetXaxis()->SetTitle("expected signal (s)");
-  flike.GetHistogram()->GetXaxis()->CenterTitle();
-  flike.GetHistogram()->GetYaxis()->SetTitle("expected background (b)");
-  flike.GetHistogram()->GetYaxis()->CenterTitle();
   clike.cd();
-  flike.Draw("contz");
+  hlike.Draw("contz");
+  hcontour->Draw("cont3 same");
   graph.Draw("C");
 
   double xpos = 0.20;
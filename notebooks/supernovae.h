@@ -0,0 +1,229 @@
+#ifndef SUPERNOVAE_H
+#define SUPERNOVAE_H
+//-----------------------------------------------------------------------
+// File: supernovae.h
+// Description: Resident Type Ia supernova dataset for CosmicCode.
+//
+//              The columns are stored as separate 32-byte aligned arrays
+//              (structure of arrays) padded to a multiple of 4 entries,
+//              so that the kernels below can process 4 supernovae per
+//              AVX2 instruction without a remainder loop. The padding
+//              has zero weight.
+//
+//              Quantities that depend only on the data are computed
+//              once: the inverse variances w = 1/dx^2, 5 log10(z) and,
+//              once a table is attached, the Chebyshev variable
+//              t = 2 z / zmax - 1.
+//
+//              The AVX2 kernels are selected at run time; a scalar
+//              version is used on other processors.
+//
+// Created: Oct. 2026
+//-----------------------------------------------------------------------
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SUPERNOVAE_AVX2
+#endif
+//-----------------------------------------------------------------------
+// minimal allocator for 32-byte aligned columns
+template <class T>
+struct AlignedAllocator
+{
+  typedef T value_type;
+  enum { ALIGNMENT = 32 };
+
+  AlignedAllocator() {}
+  template <class U> AlignedAllocator(const AlignedAllocator<U>&) {}
+
+  T* allocate(std::size_t n)
+  {
+    void* ptr = 0;
+    if ( posix_memalign(&ptr, ALIGNMENT, n*sizeof(T) + ALIGNMENT) != 0 )
+      throw std::bad_alloc();
+    return static_cast<T*>(ptr);
+  }
+  void deallocate(T* ptr, std::size_t) { free(ptr); }
+
+  template <class U> struct rebind { typedef AlignedAllocator<U> other; };
+  bool operator==(const AlignedAllocator&) const { return true; }
+  bool operator!=(const AlignedAllocator&) const { return false; }
+};
+
+typedef std::vector<double, AlignedAllocator<double> > AlignedVector;
+
+//-----------------------------------------------------------------------
+struct SupernovaData
+{
+  enum { WIDTH = 4 };    // doubles per AVX2 register
+
+  int n;                 // number of supernovae
+  int size;              // n rounded up to a multiple of WIDTH
+  double zmin;
+  double zmax;
+  double tzmax;          // zmax of table for which t was computed
+
+  AlignedVector z;       // redshift
+  AlignedVector x;       // distance modulus
+  AlignedVector w;       // 1 / dx^2 (0 for padding)
+  AlignedVector l5z;     // 5 log10(z)
+  AlignedVector t;       // 2 z / tzmax - 1
+  AlignedVector m;       // scratch: model distance modulus
+
+  SupernovaData() : n(0), size(0), zmin(0), zmax(0), tzmax(0) {}
+
+  SupernovaData(double* _z, double* _x, double* _dx, int _n)
+    : n(0), size(0), zmin(0), zmax(0), tzmax(0)
+  {
+    set(_z, _x, _dx, _n);
+  }
+
+  ~SupernovaData() {}
+
+  void set(double* _z, double* _x, double* _dx, int _n)
+  {
+    n    = _n;
+    size = WIDTH * ((n + WIDTH - 1) / WIDTH);
+    z.assign(size, 0);
+    x.assign(size, 0);
+    w.assign(size, 0);
+    l5z.assign(size, 0);
+    t.assign(size, 0);
+    m.assign(size, 0);
+    tzmax = 0;
+    zmin = n > 0 ? _z[0] : 0;
+    zmax = zmin;
+    for(int i=0; i < n; i++)
+      {
+        z[i]   = _z[i];
+        x[i]   = _x[i];
+        w[i]   = 1.0 / (_dx[i]*_dx[i]);
+        l5z[i] = 5*log10(_z[i]);
+        if ( z[i] < zmin ) zmin = z[i];
+        if ( z[i] > zmax ) zmax = z[i];
+      }
+  }
+
+  // true if all redshifts lie within [0, Z], in which case the
+  // Chebyshev variable for a table with that range is computed
+  bool bind(double Z)
+  {
+    if ( n == 0 || zmin < 0 || zmax > Z ) return false;
+    if ( Z != tzmax )
+      {
+        for(int i=0; i < n; i++) t[i] = 2*z[i]/Z - 1;
+        tzmax = Z;
+      }
+    return true;
+  }
+
+  // m = sum_j c_j T_j(t) + 5 log10(z), for all supernovae
+  void series(const double* c, int order)
+  {
+#ifdef SUPERNOVAE_AVX2
+    if ( avx2() ) { seriesAVX2(c, order); return; }
+#endif
+    for(int i=0; i < size; i++)
+      {
+        double t2 = 2*t[i];
+        double b1 = 0;
+        double b2 = 0;
+        for(int j=order-1; j > 0; j--)
+          {
+            double b0 = t2*b1 - b2 + c[j];
+            b2 = b1;
+            b1 = b0;
+          }
+        m[i] = t[i]*b1 - b2 + c[0] + l5z[i];
+      }
+  }
+
+  // Accumulate S[0] = sum w, S[1] = sum w r and S[2] = sum w r^2, where
+  // r = x - m - H is the residual
+  void sums(double H, double* S)
+  {
+#ifdef SUPERNOVAE_AVX2
+    if ( avx2() ) { sumsAVX2(H, S); return; }
+#endif
+    double S0 = 0;
+    double S1 = 0;
+    double S2 = 0;
+    for(int i=0; i < size; i++)
+      {
+        double r  = x[i] - m[i] - H;
+        double wr = w[i]*r;
+        S0 += w[i];
+        S1 += wr;
+        S2 += wr*r;
+      }
+    S[0] = S0;
+    S[1] = S1;
+    S[2] = S2;
+  }
+
+#ifdef SUPERNOVAE_AVX2
+  static bool avx2()
+  {
+    static const bool yes = __builtin_cpu_supports("avx2") &&
+      __builtin_cpu_supports("fma");
+    return yes;
+  }
+
+  __attribute__((target("avx2,fma")))
+  void seriesAVX2(const double* c, int order)
+  {
+    const double* T = &t[0];
+    const double* L = &l5z[0];
+    double* M = &m[0];
+    for(int i=0; i < size; i += WIDTH)
+      {
+        __m256d tt = _mm256_load_pd(T + i);
+        __m256d t2 = _mm256_add_pd(tt, tt);
+        __m256d b1 = _mm256_setzero_pd();
+        __m256d b2 = _mm256_setzero_pd();
+        for(int j=order-1; j > 0; j--)
+          {
+            __m256d b0 = _mm256_fmsub_pd(t2, b1, b2);
+            b0 = _mm256_add_pd(b0, _mm256_set1_pd(c[j]));
+            b2 = b1;
+            b1 = b0;
+          }
+        __m256d y = _mm256_fmsub_pd(tt, b1, b2);
+        y = _mm256_add_pd(y, _mm256_set1_pd(c[0]));
+        _mm256_store_pd(M + i, _mm256_add_pd(y, _mm256_load_pd(L + i)));
+      }
+  }
+
+  __attribute__((target("avx2,fma")))
+  void sumsAVX2(double H, double* S)
+  {
+    const double* X = &x[0];
+    const double* W = &w[0];
+    const double* M = &m[0];
+    __m256d h  = _mm256_set1_pd(H);
+    __m256d s0 = _mm256_setzero_pd();
+    __m256d s1 = _mm256_setzero_pd();
+    __m256d s2 = _mm256_setzero_pd();
+    for(int i=0; i < size; i += WIDTH)
+      {
+        __m256d ww = _mm256_load_pd(W + i);
+        __m256d r  = _mm256_sub_pd(_mm256_load_pd(X + i),
+                                   _mm256_load_pd(M + i));
+        r = _mm256_sub_pd(r, h);
+        __m256d wr = _mm256_mul_pd(ww, r);
+        s0 = _mm256_add_pd(s0, ww);
+        s1 = _mm256_add_pd(s1, wr);
+        s2 = _mm256_fmadd_pd(wr, r, s2);
+      }
+    double a[WIDTH];
+    _mm256_storeu_pd(a, s0); S[0] = (a[0] + a[1]) + (a[2] + a[3]);
+    _mm256_storeu_pd(a, s1); S[1] = (a[0] + a[1]) + (a[2] + a[3]);
+    _mm256_storeu_pd(a, s2); S[2] = (a[0] + a[1]) + (a[2] + a[3]);
+  }
+#endif
+};
+
+#endif
@@ -11,6 +11,8 @@
 #include <algorithm>
 #include <cmath>
 #include <stdlib.h>
+#include <stdio.h>
+#include <sys/resource.h>
 
 #include "TROOT.h"
 #include "TMath.h"
@@ -18,6 +20,7 @@
 #include "TLatex.h"
 #include "TFile.h"
 #include "TH1F.h"
+#include "TList.h"
 #include "TCanvas.h"
 
 #include "TStyle.h"
@@ -45,6 +48,26 @@ namespace {
   const int HEIGHT   = 500;
   const double TEXTSIZE = 0.04;
   const double MARKERSIZE = 0.8;
+
+  // set some reasonable defaults
+  void mkstyle(TH1F* h, string xtitle, string ytitle, int color)
+  {
+    h->SetLineColor(color);
+    h->SetMarkerSize(1);
+    h->SetMarkerColor(color);
+    h->SetMarkerStyle(20);
+
+    //h->GetXaxis()->CenterTitle();
+    h->GetXaxis()->SetTitle(xtitle.c_str());
+    h->GetXaxis()->SetTitleOffset(1.3);
+    h->SetNdivisions(504, "X");
+    h->SetMarkerSize(1.0);
+
+    //h->GetYaxis()->CenterTitle();
+    h->GetYaxis()->SetTitle(ytitle.c_str());
+    h->GetYaxis()->SetTitleOffset(1.4); // 1.8
+    h->SetNdivisions(504, "Y");
+  }
 }
 // ----------------------------------------------------------------------------
 
@@ -235,25 +258,7 @@ TH1F* mkhist1(string hname,
               int color)
 {
   TH1F* h = new TH1F(hname.c_str(), "", nbins, bins);
-
-  // Set some reasonable defaults
-
-  h->SetLineColor(color);
-  h->SetMarkerSize(1);
-  h->SetMarkerColor(color);
-  h->SetMarkerStyle(20);
-
-  //h->GetXaxis()->CenterTitle();
-  h->GetXaxis()->SetTitle(xtitle.c_str());
-  h->GetXaxis()->SetTitleOffset(1.3);
-  h->SetNdivisions(504, "X");
-  h->SetMarkerSize(1.0);
-
-  //h->GetYaxis()->CenterTitle();
-  h->GetYaxis()->SetTitle(ytitle.c_str());
-  h->GetYaxis()->SetTitleOffset(1.4); // 1.8
-  h->SetNdivisions(504, "Y");
-
+  mkstyle(h, xtitle, ytitle, color);
   return h;
 }
 
@@ -281,6 +286,206 @@ TH1F* mkhist1(string hname,
   return mkhist1(hname, xtitle, ytitle, nbins, &bins[0], color);
 }
 
+// ----------------------------------------------------------------------------
+// HistogramPool
+// Histograms are keyed by their binning: {0, nbins, xmin, xmax} for 
+// uniform bins and {1, edges...} otherwise.
+// ----------------------------------------------------------------------------
+HistogramPool::HistogramPool()
+  : released(),
+    owned(),
+    footprint(),
+    busy(),
+    nalloc(0),
+    nreuse(0),
+    nbytes(0),
+    maxbytes(0),
+    maxbusy(0)
+{}
+
+HistogramPool::~HistogramPool() { clear(); }
+
+TH1F* HistogramPool::get(string hname, 
+                         string xtitle, string ytitle, 
+                         int nbins, 
+                         double* bins,
+                         int color)
+{
+  if ( nbins <= 0 || bins == 0 )
+    {
+      cout << "** HistogramPool ** nbins needs to be > 0" << endl;
+      return 0;
+    }
+  vector<double> key(1, 1);
+  key.insert(key.end(), bins, bins+nbins+1);
+  return get(key, hname, xtitle, ytitle, color);
+}
+
+TH1F* HistogramPool::get(string hname, 
+                         string xtitle, string ytitle, 
+                         vector<double>& bins,
+                         int color)
+{
+  if ( bins.size() < 2 )
+    {
+      cout << "** HistogramPool ** nbins needs to be > 0" << endl;
+      return 0;
+    }
+  return get(hname, xtitle, ytitle, bins.size()-1, &bins[0], color);
+}
+
+TH1F* HistogramPool::get(string hname, 
+                         string xtitle, string ytitle, 
+                         int nbins, double xmin, double xmax,
+                         int color)
+{
+  if ( nbins <= 0 )
+    {
+      cout << "** HistogramPool ** nbins needs to be > 0" << endl;
+      return 0;
+    }
+  vector<double> key(4);
+  key[0] = 0;
+  key[1] = nbins;
+  key[2] = xmin;
+  key[3] = xmax;
+  return get(key, hname, xtitle, ytitle, color);
+}
+
+TH1F* HistogramPool::get(vector<double>& key,
+                         string hname, string xtitle, string ytitle, 
+                         int color)
+{
+  TH1F* h = 0;
+  vector<TH1F*>& pool = released[key];
+  if ( pool.size() > 0 )
+    {
+      h = pool.back();
+      pool.pop_back();
+      restore(h);
+      h->SetName(hname.c_str());
+      nreuse++;
+    }
+  else
+    {
+      // keep the histogram out of gDirectory
+      bool add = TH1::AddDirectoryStatus();
+      TH1::AddDirectory(kFALSE);
+      if ( key[0] == 0 )
+        h = new TH1F(hname.c_str(), "", (int)key[1], key[2], key[3]);
+      else
+        h = new TH1F(hname.c_str(), "", key.size()-2, &key[1]);
+      TH1::AddDirectory(add);
+      owned[h] = key;
+      nalloc++;
+    }
+  mkstyle(h, xtitle, ytitle, color);
+  busy.insert(h);
+
+  account(h);
+  maxbytes = max(maxbytes, nbytes);
+  maxbusy  = max(maxbusy, (int)busy.size());
+  return h;
+}
+
+void HistogramPool::release(TH1F* h)
+{
+  if ( busy.erase(h) == 0 )
+    {
+      cout << "** HistogramPool ** histogram not in use" << endl;
+      return;
+    }
+  account(h);
+  released[owned[h]].push_back(h);
+}
+
+void HistogramPool::releaseAll()
+{
+  while ( busy.size() > 0 ) release(*busy.begin());
+}
+
+void HistogramPool::clear()
+{
+  for(map<TH1F*, vector<double> >::iterator it=owned.begin(); 
+      it != owned.end(); ++it)
+    delete it->first;
+  owned.clear();
+  footprint.clear();
+  released.clear();
+  busy.clear();
+  nbytes = 0;
+}
+
+// return a histogram to the state of a new one with the same binning
+void HistogramPool::restore(TH1F* h)
+{
+  h->Reset();
+  h->Sumw2(kFALSE);
+  h->GetListOfFunctions()->Delete();
+  h->SetTitle("");
+  h->SetMinimum(-1111);
+  h->SetMaximum(-1111);
+  h->SetNormFactor(0);
+  h->SetOption("");
+  h->SetBinErrorOption(TH1::kNormal);
+  h->SetCanExtend(TH1::kNoAxis);
+
+  // line, fill, marker, bar, statistics and axis attributes, as set 
+  // for a new histogram
+  h->UseCurrentStyle();
+  TAxis* axes[3] = {h->GetXaxis(), h->GetYaxis(), h->GetZaxis()};
+  for(int i=0; i < 3; i++)
+    {
+      axes[i]->SetTitle("");
+      axes[i]->SetRange(0, 0);
+      axes[i]->SetTimeDisplay(0);
+      axes[i]->CenterTitle(kFALSE);
+      axes[i]->CenterLabels(kFALSE);
+      axes[i]->RotateTitle(kFALSE);
+      axes[i]->SetNoExponent(kFALSE);
+      axes[i]->SetMoreLogLabels(kFALSE);
+    }
+}
+
+// update the memory held, since a histogram may have grown while in
+// use (e.g., through Sumw2) or shrunk when reset
+void HistogramPool::account(TH1F* h)
+{
+  long b = sizeof(TH1F) 
+    + h->GetNcells() * sizeof(float) 
+    + h->GetXaxis()->GetXbins()->GetSize() * sizeof(double)
+    + h->GetSumw2N() * sizeof(double);
+  long& old = footprint[h];
+  nbytes += b - old;
+  old = b;
+}
+
+void HistogramPool::print(ostream& os) const
+{
+  char record[80];
+  sprintf(record, "%-24s %10d (%d in use)", 
+          "histograms", size(), inUse());
+  os << record << endl;
+  sprintf(record, "%-24s %10ld (%ld reused)", 
+          "allocations", nalloc, nreuse);
+  os << record << endl;
+  sprintf(record, "%-24s %10.1f kB", "memory", nbytes/1024.0);
+  os << record << endl;
+  sprintf(record, "%-24s %10.1f kB (%d in use)", 
+          "memory high-water mark", maxbytes/1024.0, maxbusy);
+  os << record << endl;
+
+  // peak resident memory of the process (kB on Linux)
+  struct rusage usage;
+  if ( getrusage(RUSAGE_SELF, &usage) == 0 )
+    {
+      sprintf(record, "%-24s %10.1f MB", 
+              "process peak resident", usage.ru_maxrss/1024.0);
+      os << record << endl;
+    }
+}
+
+// ----------------------------------------------------------------------------
 Scribe::Scribe()
   : xpos(0),
     ypos(0),
@@ -3,6 +3,9 @@
 
 #include <vector>
 #include <string>
+#include <map>
+#include <set>
+#include <iostream>
 
 #include "Math/Random.h"
 #include "Math/GSLRndmEngines.h"
@@ -47,6 +50,74 @@ std::vector<double> cdf(TH1* hist);
 void setContents(TH1* hist, std::vector<double>& c);
 void setErrors(TH1* hist, std::vector<double>& err);
 
+/// Factory for histograms that it owns and deletes. The histograms are
+/// not registered in gDirectory, so names may repeat. A released
+/// histogram is reused for the next request with the same binning,
+/// so toy loops do not reallocate or leak. Before reuse it is
+/// returned to the state of a new histogram: contents, statistics,
+/// attached functions, axis ranges and titles, and the line, fill,
+/// marker and axis attributes of the current style.
+class HistogramPool
+{
+public:
+  HistogramPool();
+  ~HistogramPool();
+
+  TH1F* get(std::string hname, 
+            std::string xtitle, std::string ytitle, 
+            int nbins,             
+            double* bins,
+            int color=kBlue);
+
+  TH1F* get(std::string hname, 
+            std::string xtitle, std::string ytitle, 
+            std::vector<double>& bins,
+            int color=kBlue);
+
+  TH1F* get(std::string hname, 
+            std::string xtitle, std::string ytitle, 
+            int nbins, double xmin, double xmax,
+            int color=kBlue);
+
+  /// return a histogram to the pool for reuse
+  void release(TH1F* h);
+  /// return all histograms to the pool
+  void releaseAll();
+  /// delete all histograms
+  void clear();
+
+  int  size() const { return owned.size(); }
+  int  inUse() const { return busy.size(); }
+  long allocations() const { return nalloc; }
+  long reuses() const { return nreuse; }
+  long bytes() const { return nbytes; }          ///< held now (approx.)
+  long maxBytes() const { return maxbytes; }     ///< high-water mark
+  int  maxInUse() const { return maxbusy; }      ///< high-water mark
+
+  void print(std::ostream& os=std::cout) const;
+
+private:
+  HistogramPool(const HistogramPool&);
+  HistogramPool& operator=(const HistogramPool&);
+
+  TH1F* get(std::vector<double>& key,
+            std::string hname, std::string xtitle, std::string ytitle, 
+            int color);
+  void restore(TH1F* h);
+  void account(TH1F* h);
+
+  // binning -> released histograms with that binning
+  std::map<std::vector<double>, std::vector<TH1F*> > released;
+  std::map<TH1F*, std::vector<double> > owned;
+  std::map<TH1F*, long> footprint;               // bytes
+  std::set<TH1F*> busy;
+  long nalloc;
+  long nreuse;
+  long nbytes;
+  long maxbytes;
+  int  maxbusy;
+};
+
 /// Simple wrapper around TLatex that uses NDC coordinates
 class Scribe
 {